@@ -2,23 +2,77 @@
   Next, build a version of the sloppy counter. Once again, measure its
   performance as the number of threads varies, as well as the thresh-
   old. Do the numbers match what you see in the chapter?
+
+  gcc -o bin/approximate_counter approximate_counter.c lock.c percpu.c worker_pool.c timer.c
+  gcc -DTHREAD_COUNT=32 -o bin/approximate_counter approximate_counter.c lock.c percpu.c worker_pool.c timer.c
+
+  ./approximate_counter            update throughput for every mode as threads vary
+  ./approximate_counter threshold  throughput against read lag, fixed vs adaptive threshold
+  ./approximate_counter read       update throughput while readers poll, by read method
+  LOCK_KIND=ticket ./approximate_counter  any of the above with a different lock
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include "lock.h"
+#include "percpu.h"
+#include "timer.h"
+#include "worker_pool.h"
 
-#define THREAD_COUNT 4
+#ifndef THREAD_COUNT
+#define THREAD_COUNT 4 // number of local slots, and the most threads benchmarked
+#endif
 #define SAMPLE_COUNT 10
 #define MAX_COUNT 4000000
 #define THRESHOLD 1
+#define READ_INTERVAL 100000 // nsecs between reads in the threshold benchmark
+#define READ_THRESHOLD 1024 // threshold for the mixed read/write benchmark
+#define READER_COUNT 2
+#define MAX_CPUS 256 // per-cpu slots, counts from higher cpus go straight to the global count
 #define NSEC_IN_SEC 1000000000 // 1,000,000,000
 
+typedef enum counter_mode_t {
+  MUTEX_COUNTER,  // local counts behind a lock each (lock.h), packed together
+  ATOMIC_COUNTER, // local counts are atomics, one per cache line, no mutex
+  PERCPU_COUNTER, // one count per cpu updated with restartable sequences
+  ADAPTIVE_COUNTER, // padded atomic slots that tune their own threshold
+  COUNTER_MODES
+} counter_mode_t;
+
+static const char *counter_mode_names[COUNTER_MODES] = { "mutex", "atomic", "percpu", "adaptive" };
+
+// a local count alone on its cache line, so updates from one thread
+// never invalidate the line another thread is counting on
+typedef struct padded_slot_t {
+  _Alignas(CACHE_LINE_SIZE) atomic_int count;
+  atomic_int threshold;  // adaptive mode only
+  atomic_int read_epoch; // adaptive mode only, reads seen at the last flush
+  atomic_uint flush_begin; // flushes started and finished, equal when the
+  atomic_uint flush_end;   // slot is not part way through moving its count
+} padded_slot_t;
+
+// written with plain adds under rseq, or __atomic adds when rseq is missing
+typedef struct percpu_slot_t {
+  _Alignas(CACHE_LINE_SIZE) intptr_t count;
+} percpu_slot_t;
+
 typedef struct counter_t {
+  counter_mode_t mode;
   int global_count;
-  pthread_mutex_t global_lock;
+  lock_t global_lock;
+  atomic_uint global_seq; // odd while a mutex counter flush is moving counts
   int local_thread[THREAD_COUNT];
-  pthread_mutex_t local_thread_lock[THREAD_COUNT];
+  lock_t local_thread_lock[THREAD_COUNT];
+  _Alignas(CACHE_LINE_SIZE) atomic_int atomic_global_count;
+  padded_slot_t slots[THREAD_COUNT];
+  percpu_slot_t percpu[MAX_CPUS];
+  int percpu_rseq;
+  _Alignas(CACHE_LINE_SIZE) atomic_int read_epoch; // bumped by every adaptive read
+  int max_threshold;
   int threshold;
 } counter_t;
 
@@ -27,36 +81,177 @@ typedef struct args_t {
   counter_t *c;
 } args_t;
 
-typedef struct timespec timespec_t;
+typedef struct reader_args_t {
+  counter_t *c;
+  int (*read)(counter_t *c);
+  atomic_int stop;
+  int reads;
+  int max_lag;
+  uint64_t total_lag;
+} reader_args_t;
 
-void init_counter(counter_t *c, int threshold) {
+// for ADAPTIVE_COUNTER threshold is the most get_global_count may be out
+// by, shared evenly between the slots
+void init_counter(counter_t *c, int threshold, counter_mode_t mode) {
+  c->mode = mode;
   c->threshold = threshold;
+  c->max_threshold = threshold / THREAD_COUNT > 1 ? threshold / THREAD_COUNT : 1;
+  atomic_init(&c->read_epoch, 0);
   c->global_count = 0;
-  pthread_mutex_init(&c->global_lock, NULL);
+  lock_init(&c->global_lock, lock_default_kind());
+  atomic_init(&c->global_seq, 0);
+  atomic_init(&c->atomic_global_count, 0);
   for (int i = 0; i < THREAD_COUNT; i++) {
     c->local_thread[i] = 0;
-    pthread_mutex_init(&c->local_thread_lock[i], NULL);
+    lock_init(&c->local_thread_lock[i], lock_default_kind());
+    atomic_init(&c->slots[i].count, 0);
+    atomic_init(&c->slots[i].threshold, 1);
+    atomic_init(&c->slots[i].read_epoch, 0);
+    atomic_init(&c->slots[i].flush_begin, 0);
+    atomic_init(&c->slots[i].flush_end, 0);
   }
+  for (int i = 0; i < MAX_CPUS; i++) {
+    c->percpu[i].count = 0;
+  }
+  c->percpu_rseq = percpu_rseq_available();
 }
 
-void update_counter(counter_t *c, int thread_id, int amount) {
+// counts are written with __atomic stores only so get_exact_count can
+// read them without taking the locks
+static void update_mutex_counter(counter_t *c, int thread_id, int amount) {
   int cpu = thread_id % THREAD_COUNT;
-  pthread_mutex_lock(&c->local_thread_lock[cpu]);
-  c->local_thread[cpu] += amount;
-  if (c->local_thread[cpu] >= c->threshold) {
-    pthread_mutex_lock(&c->global_lock);
-    c->global_count += c->local_thread[cpu];
-    pthread_mutex_unlock(&c->global_lock);
-    c->local_thread[cpu] = 0;
+  lock_acquire(&c->local_thread_lock[cpu]);
+  int local = c->local_thread[cpu] + amount;
+  __atomic_store_n(&c->local_thread[cpu], local, __ATOMIC_RELAXED);
+  if (local >= c->threshold) {
+    lock_acquire(&c->global_lock);
+    // global_lock makes this the only writer of global_seq
+    unsigned seq = atomic_load_explicit(&c->global_seq, memory_order_relaxed);
+    atomic_store_explicit(&c->global_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    __atomic_store_n(&c->global_count, c->global_count + local, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->local_thread[cpu], 0, __ATOMIC_RELAXED);
+    atomic_store_explicit(&c->global_seq, seq + 2, memory_order_release);
+    lock_release(&c->global_lock);
+  }
+  lock_release(&c->local_thread_lock[cpu]);
+}
+
+// bracket moving a slot's count into the global count, several threads
+// can share a slot so these are counters rather than one odd/even sequence
+static void begin_flush(padded_slot_t *slot) {
+  atomic_fetch_add_explicit(&slot->flush_begin, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void end_flush(padded_slot_t *slot) {
+  atomic_fetch_add_explicit(&slot->flush_end, 1, memory_order_release);
+}
+
+static void update_atomic_counter(counter_t *c, int thread_id, int amount) {
+  padded_slot_t *slot = &c->slots[thread_id % THREAD_COUNT];
+  int local = atomic_fetch_add_explicit(&slot->count, amount, memory_order_relaxed) + amount;
+  if (local >= c->threshold) {
+    // threads sharing a slot may both cross the threshold, the exchange
+    // hands whatever is left to exactly one of them
+    begin_flush(slot);
+    int flushed = atomic_exchange_explicit(&slot->count, 0, memory_order_relaxed);
+    if (flushed != 0) {
+      atomic_fetch_add_explicit(&c->atomic_global_count, flushed, memory_order_relaxed);
+    }
+    end_flush(slot);
+  }
+}
+
+// the slot belongs to whichever thread is on that cpu, so there is nothing
+// to flush, readers sum the slots instead. the threshold is not used.
+static void update_percpu_counter(counter_t *c, int thread_id, int amount) {
+  if (c->percpu_rseq) {
+    if (percpu_add(&c->percpu[0].count, sizeof(percpu_slot_t), MAX_CPUS, amount) < 0) {
+      atomic_fetch_add_explicit(&c->atomic_global_count, amount, memory_order_relaxed);
+    }
+    return;
+  }
+  // without rseq another thread can be on "our" slot between picking it
+  // and the add, so the add has to be atomic
+  int cpu = percpu_current_cpu();
+  if (cpu < 0) {
+    cpu = thread_id;
+  }
+  __atomic_fetch_add(&c->percpu[cpu % MAX_CPUS].count, amount, __ATOMIC_RELAXED);
+}
+
+// flush like the mutex counter, but a slot that finds global_lock taken
+// doubles its threshold (up to max_threshold) and a slot that sees a read
+// happened since its last flush halves it, so counts stay fresh while
+// someone is looking and global_lock is left alone while nobody is
+static void update_adaptive_counter(counter_t *c, int thread_id, int amount) {
+  padded_slot_t *slot = &c->slots[thread_id % THREAD_COUNT];
+  int local = atomic_fetch_add_explicit(&slot->count, amount, memory_order_relaxed) + amount;
+  int threshold = atomic_load_explicit(&slot->threshold, memory_order_relaxed);
+  if (local < threshold) {
+    return;
+  }
+  if (lock_try_acquire(&c->global_lock) != 0) {
+    if (threshold < c->max_threshold) {
+      threshold = threshold * 2 < c->max_threshold ? threshold * 2 : c->max_threshold;
+    }
+    lock_acquire(&c->global_lock);
+  }
+  begin_flush(slot);
+  int flushed = atomic_exchange_explicit(&slot->count, 0, memory_order_relaxed);
+  __atomic_store_n(&c->global_count, c->global_count + flushed, __ATOMIC_RELAXED);
+  end_flush(slot);
+  lock_release(&c->global_lock);
+
+  int epoch = atomic_load_explicit(&c->read_epoch, memory_order_relaxed);
+  if (epoch != atomic_load_explicit(&slot->read_epoch, memory_order_relaxed)) {
+    atomic_store_explicit(&slot->read_epoch, epoch, memory_order_relaxed);
+    threshold = threshold / 2 > 1 ? threshold / 2 : 1;
+  }
+  atomic_store_explicit(&slot->threshold, threshold, memory_order_relaxed);
+}
+
+void update_counter(counter_t *c, int thread_id, int amount) {
+  switch (c->mode) {
+    case ATOMIC_COUNTER:
+      update_atomic_counter(c, thread_id, amount);
+      break;
+    case PERCPU_COUNTER:
+      update_percpu_counter(c, thread_id, amount);
+      break;
+    case ADAPTIVE_COUNTER:
+      update_adaptive_counter(c, thread_id, amount);
+      break;
+    default:
+      update_mutex_counter(c, thread_id, amount);
+      break;
+  }
+}
+
+static int sum_percpu(counter_t *c) {
+  intptr_t sum = atomic_load_explicit(&c->atomic_global_count, memory_order_relaxed);
+  for (int i = 0; i < MAX_CPUS; i++) {
+    sum += __atomic_load_n(&c->percpu[i].count, __ATOMIC_RELAXED);
   }
-  pthread_mutex_unlock(&c->local_thread_lock[cpu]);
+  return (int) sum;
 }
 
-// approximate global count (within threshold * THREAD_COUNT)
+// approximate global count (within threshold * THREAD_COUNT), the per-cpu
+// count only misses updates made while it is being summed
 int get_global_count(counter_t *c) {
-  pthread_mutex_lock(&c->global_lock);
+  if (c->mode == ATOMIC_COUNTER) {
+    return atomic_load_explicit(&c->atomic_global_count, memory_order_relaxed);
+  }
+  if (c->mode == PERCPU_COUNTER) {
+    return sum_percpu(c);
+  }
+  if (c->mode == ADAPTIVE_COUNTER) {
+    atomic_fetch_add_explicit(&c->read_epoch, 1, memory_order_relaxed);
+  }
+  lock_acquire(&c->global_lock);
   int global_count = c->global_count;
-  pthread_mutex_unlock(&c->global_lock);
+  lock_release(&c->global_lock);
   return global_count;
 }
 
@@ -70,49 +265,275 @@ void *start_routine(void *args) {
   return NULL;
 }
 
-static uint64_t elapsed_nsecs(timespec_t *start, timespec_t *end) {
-  timespec_t temp = { 0 };
-  // its possible for (end->nsec - start->nsec) to be negative, if so subract 1 full second
-  if ((end->tv_nsec - start->tv_nsec) < 0) {
-    temp.tv_sec = end->tv_sec - start->tv_sec - 1;
-    temp.tv_nsec = NSEC_IN_SEC + end->tv_nsec - start->tv_nsec; // add value of negative nsec
-  } else {
-    temp.tv_sec = end->tv_sec - start->tv_sec;
-    temp.tv_nsec = end->tv_nsec - start->tv_nsec;
+// exact count without taking any lock, so readers never hold up writers.
+// a snapshot is retried if a flush moved counts from a slot to the global
+// count while it was being summed, updates that stay in their slot only
+// ever add to the total so summing around them is still exact.
+int get_exact_count(counter_t *c) {
+  int sum = 0;
+  if (c->mode == PERCPU_COUNTER) {
+    // nothing is ever moved between slots
+    return sum_percpu(c);
+  }
+  if (c->mode == MUTEX_COUNTER) {
+    for (;;) {
+      unsigned seq = atomic_load_explicit(&c->global_seq, memory_order_acquire);
+      if (seq & 1) {
+        continue;
+      }
+      sum = __atomic_load_n(&c->global_count, __ATOMIC_RELAXED);
+      for (int i = 0; i < THREAD_COUNT; i++) {
+        sum += __atomic_load_n(&c->local_thread[i], __ATOMIC_RELAXED);
+      }
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&c->global_seq, memory_order_relaxed) == seq) {
+        return sum;
+      }
+    }
+  }
+  unsigned begin[THREAD_COUNT];
+  for (;;) {
+    int flushing = 0;
+    for (int i = 0; i < THREAD_COUNT && !flushing; i++) {
+      unsigned end = atomic_load_explicit(&c->slots[i].flush_end, memory_order_acquire);
+      begin[i] = atomic_load_explicit(&c->slots[i].flush_begin, memory_order_acquire);
+      flushing = begin[i] != end;
+    }
+    if (flushing) {
+      continue;
+    }
+    if (c->mode == ADAPTIVE_COUNTER) {
+      sum = __atomic_load_n(&c->global_count, __ATOMIC_RELAXED);
+    } else {
+      sum = atomic_load_explicit(&c->atomic_global_count, memory_order_relaxed);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+      sum += atomic_load_explicit(&c->slots[i].count, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    int changed = 0;
+    for (int i = 0; i < THREAD_COUNT && !changed; i++) {
+      changed = atomic_load_explicit(&c->slots[i].flush_begin, memory_order_relaxed) != begin[i];
+    }
+    if (!changed) {
+      return sum;
+    }
   }
-  return (temp.tv_sec * NSEC_IN_SEC) + temp.tv_nsec;
 }
 
-int main() {
+// exact count the old way, holding every lock. blocks writers while it runs
+int get_locked_count(counter_t *c) {
+  if (c->mode != MUTEX_COUNTER) {
+    return get_exact_count(c);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    lock_acquire(&c->local_thread_lock[i]);
+  }
+  lock_acquire(&c->global_lock);
+  int sum = c->global_count;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    sum += c->local_thread[i];
+  }
+  lock_release(&c->global_lock);
+  for (int i = THREAD_COUNT - 1; i >= 0; i--) {
+    lock_release(&c->local_thread_lock[i]);
+  }
+  return sum;
+}
+
+// counts sitting in local slots, i.e. how far behind get_global_count is.
+// read without the slot locks, it is only an estimate while updates run
+static int unflushed_count(counter_t *c) {
+  int sum = 0;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    if (c->mode == MUTEX_COUNTER) {
+      sum += __atomic_load_n(&c->local_thread[i], __ATOMIC_RELAXED);
+    } else {
+      sum += atomic_load_explicit(&c->slots[i].count, memory_order_relaxed);
+    }
+  }
+  return sum;
+}
+
+// reads the counter every READ_INTERVAL until stopped, recording the lag
+void *reader_routine(void *args) {
+  reader_args_t *r = (reader_args_t *) args;
+  timespec_t interval = { 0, READ_INTERVAL };
+  while (!atomic_load(&r->stop)) {
+    get_global_count(r->c);
+    int lag = unflushed_count(r->c);
+    r->reads++;
+    r->total_lag += lag;
+    if (lag > r->max_lag) {
+      r->max_lag = lag;
+    }
+    nanosleep(&interval, NULL);
+  }
+  return NULL;
+}
+
+// calls the reader's read function back to back until stopped
+void *spin_reader_routine(void *args) {
+  reader_args_t *r = (reader_args_t *) args;
+  while (!atomic_load_explicit(&r->stop, memory_order_relaxed)) {
+    r->read(r->c);
+    r->reads++;
+  }
+  return NULL;
+}
+
+// average time for thread_count threads to each add MAX_COUNT to the counter,
+// the threads are parked in the pool between samples so only the update
+// loop is timed
+static uint64_t run_benchmark(worker_pool_t *pool, counter_mode_t mode, int thread_count) {
   counter_t c;
-  init_counter(&c, THRESHOLD);
+  // the adaptive bound is the total error, the same as THRESHOLD in every slot
+  init_counter(&c, mode == ADAPTIVE_COUNTER ? THRESHOLD * THREAD_COUNT : THRESHOLD, mode);
 
   args_t args[THREAD_COUNT];
-  pthread_t threads[THREAD_COUNT];
+  for (int i = 0; i < thread_count; i++) {
+    args[i].c = &c;
+    args[i].thread_id = i;
+  }
 
-  timespec_t t1, t2;
   uint64_t samples[SAMPLE_COUNT] = { 0 };
 
   for (int sample = 0; sample < SAMPLE_COUNT; sample++) {
-    clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-    for (int i = 0; i < THREAD_COUNT; i++) {
-      args[i].c = &c;
-      args[i].thread_id = i;
-      pthread_create(&threads[i], NULL, start_routine, &args[i]);
+    samples[sample] = pool_run(pool, thread_count, start_routine, args, sizeof(args_t));
+  }
+
+  return average_cost(samples, SAMPLE_COUNT);
+}
+
+// all THREAD_COUNT threads updating while one reader polls. a fixed
+// threshold on the same padded atomic slots the adaptive counter uses,
+// against the adaptive one with the same error bound, so the threshold
+// policy is the only difference. the mutex counter is there for reference
+static void run_threshold_benchmark(worker_pool_t *pool) {
+  static const int thresholds[] = { 1, 16, 256, 4096, 65536 };
+  static counter_t c;
+
+  args_t args[THREAD_COUNT];
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    args[i].c = &c;
+    args[i].thread_id = i;
+  }
+
+  for (int i = 0; i < (int) (sizeof(thresholds) / sizeof(thresholds[0])); i++) {
+    counter_mode_t modes[] = { MUTEX_COUNTER, ATOMIC_COUNTER, ADAPTIVE_COUNTER };
+    for (int m = 0; m < (int) (sizeof(modes) / sizeof(modes[0])); m++) {
+      // same worst case error, THREAD_COUNT slots each short of a flush
+      int bound = modes[m] == ADAPTIVE_COUNTER ? thresholds[i] * THREAD_COUNT : thresholds[i];
+      init_counter(&c, bound, modes[m]);
+
+      reader_args_t reader = { .c = &c };
+      atomic_init(&reader.stop, 0);
+      pthread_t reader_thread;
+      pthread_create(&reader_thread, NULL, reader_routine, &reader);
+
+      uint64_t elapsed = pool_run(pool, THREAD_COUNT, start_routine, args, sizeof(args_t));
+
+      atomic_store(&reader.stop, 1);
+      pthread_join(reader_thread, NULL);
+
+      double ops_per_sec = (double) THREAD_COUNT * MAX_COUNT * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-8s threshold: %6d ops/sec: %11.0f reads: %6d max lag: %8d avg lag: %8llu\n",
+        counter_mode_names[modes[m]], thresholds[i], ops_per_sec, reader.reads, reader.max_lag,
+        reader.reads ? reader.total_lag / reader.reads : 0);
     }
-    for (int i = 0; i < THREAD_COUNT; i++) {
-      pthread_join(threads[i], NULL);
+  }
+}
+
+// all THREAD_COUNT threads updating while READER_COUNT threads read as
+// fast as they can, to see what each way of reading costs the writers
+static void run_read_benchmark(worker_pool_t *pool) {
+  typedef struct read_config_t {
+    counter_mode_t mode;
+    const char *name;
+    int (*read)(counter_t *c);
+  } read_config_t;
+  static const read_config_t configs[] = {
+    { MUTEX_COUNTER, "none", NULL },
+    { MUTEX_COUNTER, "global", get_global_count },
+    { MUTEX_COUNTER, "locked", get_locked_count },
+    { MUTEX_COUNTER, "exact", get_exact_count },
+    { ATOMIC_COUNTER, "none", NULL },
+    { ATOMIC_COUNTER, "global", get_global_count },
+    { ATOMIC_COUNTER, "exact", get_exact_count },
+  };
+  static counter_t c;
+
+  args_t args[THREAD_COUNT];
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    args[i].c = &c;
+    args[i].thread_id = i;
+  }
+
+  for (int i = 0; i < (int) (sizeof(configs) / sizeof(configs[0])); i++) {
+    const read_config_t *config = &configs[i];
+    init_counter(&c, READ_THRESHOLD, config->mode);
+
+    int reader_count = config->read ? READER_COUNT : 0;
+    reader_args_t readers[READER_COUNT] = { 0 };
+    pthread_t reader_threads[READER_COUNT];
+    for (int r = 0; r < reader_count; r++) {
+      readers[r].c = &c;
+      readers[r].read = config->read;
+      atomic_init(&readers[r].stop, 0);
+      pthread_create(&reader_threads[r], NULL, spin_reader_routine, &readers[r]);
     }
-    clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
-    samples[sample] = elapsed_nsecs(&t1, &t2);
+
+    uint64_t elapsed = pool_run(pool, THREAD_COUNT, start_routine, args, sizeof(args_t));
+
+    int reads = 0;
+    for (int r = 0; r < reader_count; r++) {
+      atomic_store(&readers[r].stop, 1);
+      pthread_join(reader_threads[r], NULL);
+      reads += readers[r].reads;
+    }
+
+    int expected = THREAD_COUNT * MAX_COUNT;
+    if (get_exact_count(&c) != expected) {
+      fprintf(stderr, "Error exact %s count is %d, expected %d\n", counter_mode_names[config->mode], get_exact_count(&c), expected);
+      exit(EXIT_FAILURE);
+    }
+
+    double ops_per_sec = (double) expected * NSEC_IN_SEC / elapsed;
+    double reads_per_sec = (double) reads * NSEC_IN_SEC / elapsed;
+    fprintf(stdout, "%-7s reader: %-6s update ops/sec: %11.0f reads/sec: %11.0f\n",
+      counter_mode_names[config->mode], config->name, ops_per_sec, reads_per_sec);
   }
-  
-  uint64_t sum = 0;
-  for (int i = 0; i < SAMPLE_COUNT; i++) {
-    sum += samples[i];
+}
+
+int main(int argc, char **argv) {
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+
+  fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+
+  if (argc > 1 && strcmp(argv[1], "threshold") == 0) {
+    run_threshold_benchmark(&pool);
+    pool_destroy(&pool);
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "read") == 0) {
+    run_read_benchmark(&pool);
+    pool_destroy(&pool);
+    return EXIT_SUCCESS;
+  }
+
+  fprintf(stdout, "percpu counter using %s\n", percpu_rseq_available() ? "rseq" : "atomic fallback");
+
+  for (int mode = 0; mode < COUNTER_MODES; mode++) {
+    for (int threads = 1; threads <= THREAD_COUNT; threads *= 2) {
+      uint64_t elapsed = run_benchmark(&pool, mode, threads);
+      double ops_per_sec = (double) threads * MAX_COUNT * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-7s threads: %3d elapsed time: %12llu ops/sec: %.0f\n",
+        counter_mode_names[mode], threads, elapsed, ops_per_sec);
+    }
   }
 
-  fprintf(stdout, "Elapsed time: %llu\n", sum / SAMPLE_COUNT);
+  pool_destroy(&pool);
 
   return EXIT_SUCCESS;
 }
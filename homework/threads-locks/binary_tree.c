@@ -4,38 +4,120 @@
   locking strategy such as a single lock. Measure its performance as
   the number of concurrent threads increases.
 
-  gcc -o bin/binary_tree binary_tree.c timer.c
+  gcc -o bin/binary_tree binary_tree.c btree.c compact_tree.c eytzinger.c lock.c nm_tree.c psort.c rcu.c stripe.c tree_file.c worker_pool.c timer.c
+
+  ./binary_tree         lookups of the greatest value from THREAD_COUNT threads
+  ./binary_tree mixed   lookups, inserts and deletes from 1 to THREAD_COUNT threads
+  ./binary_tree batch   contains one key at a time against contains_batch
+  ./binary_tree freeze  contains against a frozen eytzinger copy of a bulk loaded tree, 1M and 100M keys
+  ./binary_tree freeze 5000000   just the one size
+  ./binary_tree bulk    one insert_node per key against bulk_load from 1 to BULK_THREADS threads
+  ./binary_tree bulk 5000000     the same with more keys
+  ./binary_tree snapshot [file]  time to first lookup, rebuilding against mapping a saved tree
 */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "btree.h"
+#include "compact_tree.h"
+#include "eytzinger.h"
+#include "lock.h"
+#include "nm_tree.h"
+#include "psort.h"
 #include "timer.h"
+#include "tree_file.h"
+#include "worker_pool.h"
 
 typedef struct btree_node_t {
   int value;
-  int visited;
-  pthread_mutex_t node_lock;
+  _Atomic uint64_t version; // for the olc_ functions
   struct btree_node_t *left;
   struct btree_node_t *right;
 } btree_node_t;
 
 typedef struct btree_root_t {
   btree_node_t *root;
-  pthread_mutex_t root_lock;
+  lock_t root_lock;
 } btree_root_t;
 
 typedef struct args_t {
   btree_root_t *btree;
+  btree_t *b_tree;
+  nm_tree_t *nm_tree;
+  compact_tree_t *compact_tree;
   int iter;
   int target_value;
+  int path_length; // nodes a lookup of target_value visits
   pthread_mutex_t iter_lock;
   uint64_t *search_times;
 } args_t;
 
+typedef enum mixed_mode_t {
+  MIXED_SINGLE_LOCK, // the olc functions, one at a time behind the root lock
+  MIXED_OLC,
+  MIXED_LOCK_FREE,   // the natarajan-mittal tree
+  MIXED_MODES
+} mixed_mode_t;
+
+static const char *mixed_mode_names[MIXED_MODES] = { "single", "olc", "lockfree" };
+
+// one subtree of a bulk load, built from sorted[lo] to sorted[hi - 1]
+typedef struct bulk_args_t {
+  btree_node_t *arena;
+  const int *sorted;
+  size_t lo;
+  size_t hi;
+} bulk_args_t;
+
+typedef struct mixed_args_t {
+  mixed_mode_t mode;
+  btree_root_t *btree;
+  nm_tree_t *nm_tree;
+  unsigned int seed;
+  int count;
+} mixed_args_t;
+
+// one thread's visit counts, keyed by node, so counting a visit never
+// writes to memory another thread reads. every table stays on the
+// visit_tables list after its thread exits so its counts still add up
+typedef struct visit_table_t {
+  btree_node_t **nodes;
+  int *counts;
+  int capacity; // a power of two
+  int size;
+  struct visit_table_t *next;
+} visit_table_t;
+
 #define THREAD_COUNT 128
 #define NODE_COUNT 1000000
+#define MIXED_NODE_COUNT 100000 // keys in the tree before the mixed benchmark
+#define MIXED_OPS 1000000 // shared between all the threads
+#define MIXED_READ_PERCENT 90 // the rest split evenly between insert and delete
+#define BATCH_WIDTH 16 // lookups contains_batch keeps in flight
+#define BATCH_SIZE 64 // keys per contains_batch call in the benchmark
+#define BATCH_LOOKUPS 1000000
+#define FREEZE_LOOKUPS 1000000
+#define SNAPSHOT_LOOKUPS 1000000
+#define SNAPSHOT_FILE "binary_tree.snapshot"
+#define BULK_THREADS 16
+#define NSEC_IN_SEC 1000000000 // 1,000,000,000
+
+// olc version bits, see olc_read
+#define OLC_LOCKED 1
+#define OLC_OBSOLETE 2
+#define OLC_STEP 4
+
+#define VISIT_TABLE_SIZE 64 // starting capacity of each thread's table, about two lookup paths
+
+static _Atomic(visit_table_t *) visit_tables = NULL;
+static _Thread_local visit_table_t *visits = NULL;
 
 static btree_node_t *create_node(int value) {
   btree_node_t *node = NULL;
@@ -46,7 +128,7 @@ static btree_node_t *create_node(int value) {
   node->value = value;
   node->left = NULL;
   node->right = NULL;
-  node->visited = 0;
+  atomic_init(&node->version, 0);
   return node;
 }
 
@@ -54,7 +136,7 @@ static void init_btree(btree_root_t *btree, int value) {
   btree_node_t *node = NULL;
   node = create_node(value);
   btree->root = node;
-  pthread_mutex_init(&btree->root_lock, NULL);
+  lock_init(&btree->root_lock, lock_default_kind());
 }
 
 static void insert_node(btree_node_t *node, int value) {
@@ -91,11 +173,145 @@ static int contains(btree_node_t *node, int value) {
   }
 }
 
-static int contains_with_lock(btree_node_t *node, int value) {
-  // do something with the lock
-  pthread_mutex_lock(&node->node_lock);
-  node->visited += 1;
-  pthread_mutex_unlock(&node->node_lock);
+static unsigned int visit_slot(visit_table_t *table, btree_node_t *node) {
+  uint64_t hash = ((uintptr_t) node >> 4) * 0x9e3779b97f4a7c15ull;
+  unsigned int slot = hash >> 32 & (table->capacity - 1);
+  while (table->nodes[slot] != NULL && table->nodes[slot] != node) {
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+  return slot;
+}
+
+static void visit_table_alloc(visit_table_t *table, int capacity) {
+  table->capacity = capacity;
+  table->size = 0;
+  if ((table->nodes = calloc(capacity, sizeof(btree_node_t *))) == NULL ||
+      (table->counts = calloc(capacity, sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static visit_table_t *get_visit_table(void) {
+  if (visits == NULL) {
+    if ((visits = malloc(sizeof(visit_table_t))) == NULL) {
+      fprintf(stderr, "Error allocating memory\n");
+      exit(EXIT_FAILURE);
+    }
+    visit_table_alloc(visits, VISIT_TABLE_SIZE);
+    visits->next = atomic_load(&visit_tables);
+    while (!atomic_compare_exchange_weak(&visit_tables, &visits->next, visits)) {
+    }
+  }
+  return visits;
+}
+
+// kept at most half full so probes stay short
+static void grow_visit_table(visit_table_t *table) {
+  btree_node_t **nodes = table->nodes;
+  int *counts = table->counts;
+  int capacity = table->capacity;
+  visit_table_alloc(table, capacity * 2);
+  for (int i = 0; i < capacity; i++) {
+    if (nodes[i] != NULL) {
+      unsigned int slot = visit_slot(table, nodes[i]);
+      table->nodes[slot] = nodes[i];
+      table->counts[slot] = counts[i];
+      table->size++;
+    }
+  }
+  free(nodes);
+  free(counts);
+}
+
+// make room for count more nodes in this thread's table, so a lookup
+// that visits that many neither allocates nor grows it
+static void reserve_visits(int count) {
+  visit_table_t *table = get_visit_table();
+  while ((table->size + count) * 2 > table->capacity) {
+    grow_visit_table(table);
+  }
+}
+
+static void record_visit(btree_node_t *node) {
+  visit_table_t *table = get_visit_table();
+  unsigned int slot = visit_slot(table, node);
+  if (table->nodes[slot] == NULL) {
+    if ((table->size + 1) * 2 > table->capacity) {
+      grow_visit_table(table);
+      slot = visit_slot(table, node);
+    }
+    table->nodes[slot] = node;
+    table->size++;
+  }
+  table->counts[slot]++;
+}
+
+// every thread's visits to node added up, only while no lookups are running
+static int node_visits(btree_node_t *node) {
+  int total = 0;
+  for (visit_table_t *table = atomic_load(&visit_tables); table; table = table->next) {
+    unsigned int slot = visit_slot(table, node);
+    if (table->nodes[slot] == node) {
+      total += table->counts[slot];
+    }
+  }
+  return total;
+}
+
+// contains for each of keys, results[i] set to 1 if keys[i] is there.
+// BATCH_WIDTH lookups move down the tree together a level at a time, each
+// prefetching the node it goes to next, so while one waits on memory the
+// others have work to do. a lookup that finishes hands its slot to the
+// next key
+void contains_batch(btree_node_t *root, const int *keys, int n, int *results) {
+  btree_node_t *nodes[BATCH_WIDTH];
+  int index[BATCH_WIDTH];
+  int next = 0;
+  int active = 0;
+  for (int s = 0; s < BATCH_WIDTH; s++) {
+    nodes[s] = NULL;
+    if (next < n) {
+      nodes[s] = root;
+      index[s] = next++;
+      active++;
+    }
+  }
+  while (active > 0) {
+    for (int s = 0; s < BATCH_WIDTH; s++) {
+      btree_node_t *node = nodes[s];
+      if (node == NULL) {
+        continue;
+      }
+      int key = keys[index[s]];
+      if (node->value == key) {
+        results[index[s]] = 1;
+        node = NULL;
+      } else {
+        node = node->value < key ? node->left : node->right;
+        if (node == NULL) {
+          results[index[s]] = 0;
+        }
+      }
+      if (node == NULL) {
+        if (next < n) {
+          node = root;
+          index[s] = next++;
+        } else {
+          active--;
+        }
+      } else {
+        __builtin_prefetch(node);
+      }
+      nodes[s] = node;
+    }
+  }
+}
+
+// contains, counting a visit to every node on the way in this thread's
+// own table. nothing shared is written
+static int contains_with_visits(btree_node_t *node, int value) {
+  record_visit(node);
 
   if (node->value == value) {
     return 1;
@@ -103,22 +319,423 @@ static int contains_with_lock(btree_node_t *node, int value) {
     if (node->left == NULL) {
       return 0;
     } else {
-      return contains_with_lock(node->left, value);
+      return contains_with_visits(node->left, value);
     }
   } else {
     if (node->right == NULL) {
       return 0;
     } else {
-      return contains_with_lock(node->right, value);
+      return contains_with_visits(node->right, value);
+    }
+  }
+}
+
+/*
+  Optimistic lock coupling [LHN16]. Readers take no locks, they note each
+  node's version, read what they need and check the version didn't move
+  before trusting it, starting again from the root if it did. Writers
+  lock a node by setting OLC_LOCKED in a version they have already
+  validated, so they never wait while holding a lock, and unlocking bumps
+  the version. Unlinked nodes are marked OLC_OBSOLETE and never freed
+  because a reader may still be looking at them.
+
+  The root node is never removed, build the tree on an INT_MIN root so
+  every real key is below it.
+*/
+
+// 0 if a writer has the node or it has been unlinked
+static int olc_read(btree_node_t *node, uint64_t *version) {
+  *version = atomic_load_explicit(&node->version, memory_order_acquire);
+  return (*version & (OLC_LOCKED | OLC_OBSOLETE)) == 0;
+}
+
+// everything read from the node since olc_read is still what it was
+static int olc_validate(btree_node_t *node, uint64_t version) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&node->version, memory_order_relaxed) == version;
+}
+
+static int olc_upgrade(btree_node_t *node, uint64_t version) {
+  return atomic_compare_exchange_strong_explicit(&node->version, &version, version | OLC_LOCKED,
+    memory_order_acquire, memory_order_relaxed);
+}
+
+static void olc_unlock(btree_node_t *node) {
+  atomic_fetch_add_explicit(&node->version, OLC_STEP - OLC_LOCKED, memory_order_release);
+}
+
+static void olc_unlock_obsolete(btree_node_t *node) {
+  atomic_fetch_add_explicit(&node->version, OLC_OBSOLETE - OLC_LOCKED, memory_order_release);
+}
+
+// the link a search for value follows out of node
+static btree_node_t **olc_link(btree_node_t *node, int value) {
+  return __atomic_load_n(&node->value, __ATOMIC_RELAXED) < value ? &node->left : &node->right;
+}
+
+// whoever made us restart is mid update, let them finish
+static void olc_backoff(int *restarts) {
+  if (++(*restarts) % 16 == 0) {
+    sched_yield();
+  }
+}
+
+// the olc_try_ functions return -1 when they have to start again
+static int olc_try_contains(btree_root_t *btree, int value) {
+  btree_node_t *node = btree->root;
+  uint64_t version = 0;
+  if (!olc_read(node, &version)) {
+    return -1;
+  }
+  for (;;) {
+    if (__atomic_load_n(&node->value, __ATOMIC_RELAXED) == value) {
+      return olc_validate(node, version) ? 1 : -1;
+    }
+    btree_node_t *child = __atomic_load_n(olc_link(node, value), __ATOMIC_ACQUIRE);
+    if (!olc_validate(node, version)) {
+      return -1;
+    }
+    if (child == NULL) {
+      return 0;
+    }
+    uint64_t child_version = 0;
+    if (!olc_read(child, &child_version) || !olc_validate(node, version)) {
+      return -1;
+    }
+    node = child;
+    version = child_version;
+  }
+}
+
+static int olc_try_insert(btree_root_t *btree, btree_node_t *new_node) {
+  btree_node_t *node = btree->root;
+  uint64_t version = 0;
+  if (!olc_read(node, &version)) {
+    return -1;
+  }
+  for (;;) {
+    btree_node_t **link = olc_link(node, new_node->value);
+    btree_node_t *child = __atomic_load_n(link, __ATOMIC_ACQUIRE);
+    if (!olc_validate(node, version)) {
+      return -1;
+    }
+    if (child == NULL) {
+      if (!olc_upgrade(node, version)) {
+        return -1;
+      }
+      __atomic_store_n(link, new_node, __ATOMIC_RELEASE);
+      olc_unlock(node);
+      return 0;
+    }
+    uint64_t child_version = 0;
+    if (!olc_read(child, &child_version) || !olc_validate(node, version)) {
+      return -1;
+    }
+    node = child;
+    version = child_version;
+  }
+}
+
+// node has two children and is locked. its value is replaced with the
+// greatest value in its right subtree, and that node is unlinked instead
+static int olc_try_replace(btree_node_t *node) {
+  btree_node_t **link = &node->right;
+  btree_node_t *parent = node;
+  btree_node_t *succ = node->right;
+  uint64_t parent_version = 0;
+  uint64_t version = 0;
+  if (!olc_read(succ, &version)) {
+    olc_unlock(node);
+    return -1;
+  }
+  for (;;) {
+    btree_node_t *next = __atomic_load_n(&succ->left, __ATOMIC_ACQUIRE);
+    if (!olc_validate(succ, version)) {
+      olc_unlock(node);
+      return -1;
+    }
+    if (next == NULL) {
+      break;
+    }
+    uint64_t next_version = 0;
+    if (!olc_read(next, &next_version) || !olc_validate(succ, version)) {
+      olc_unlock(node);
+      return -1;
+    }
+    link = &succ->left;
+    parent = succ;
+    parent_version = version;
+    succ = next;
+    version = next_version;
+  }
+  if (parent != node && !olc_upgrade(parent, parent_version)) {
+    olc_unlock(node);
+    return -1;
+  }
+  if (!olc_upgrade(succ, version)) {
+    if (parent != node) {
+      olc_unlock(parent);
+    }
+    olc_unlock(node);
+    return -1;
+  }
+  __atomic_store_n(link, succ->right, __ATOMIC_RELEASE);
+  __atomic_store_n(&node->value, succ->value, __ATOMIC_RELAXED);
+  if (parent != node) {
+    olc_unlock(parent);
+  }
+  olc_unlock(node);
+  olc_unlock_obsolete(succ);
+  return 1;
+}
+
+static int olc_try_delete(btree_root_t *btree, int value) {
+  btree_node_t *parent = NULL;
+  btree_node_t **link = NULL;
+  btree_node_t *node = btree->root;
+  uint64_t parent_version = 0;
+  uint64_t version = 0;
+  if (!olc_read(node, &version)) {
+    return -1;
+  }
+  for (;;) {
+    if (parent != NULL && __atomic_load_n(&node->value, __ATOMIC_RELAXED) == value) {
+      break;
+    }
+    btree_node_t **next_link = olc_link(node, value);
+    btree_node_t *child = __atomic_load_n(next_link, __ATOMIC_ACQUIRE);
+    if (!olc_validate(node, version)) {
+      return -1;
+    }
+    if (child == NULL) {
+      return 0;
+    }
+    uint64_t child_version = 0;
+    if (!olc_read(child, &child_version) || !olc_validate(node, version)) {
+      return -1;
+    }
+    parent = node;
+    parent_version = version;
+    link = next_link;
+    node = child;
+    version = child_version;
+  }
+
+  // once node is locked its children can't change
+  if (!olc_upgrade(node, version)) {
+    return -1;
+  }
+  if (node->left != NULL && node->right != NULL) {
+    return olc_try_replace(node);
+  }
+  if (!olc_upgrade(parent, parent_version)) {
+    olc_unlock(node);
+    return -1;
+  }
+  __atomic_store_n(link, node->left ? node->left : node->right, __ATOMIC_RELEASE);
+  olc_unlock(parent);
+  olc_unlock_obsolete(node);
+  return 1;
+}
+
+int olc_contains(btree_root_t *btree, int value) {
+  int restarts = 0;
+  int rv = 0;
+  while ((rv = olc_try_contains(btree, value)) < 0) {
+    olc_backoff(&restarts);
+  }
+  return rv;
+}
+
+// like insert_node, equal values go right
+void olc_insert(btree_root_t *btree, int value) {
+  btree_node_t *node = create_node(value);
+  int restarts = 0;
+  while (olc_try_insert(btree, node) < 0) {
+    olc_backoff(&restarts);
+  }
+}
+
+// 1 if a node holding value was removed, 0 if there wasn't one
+int olc_delete(btree_root_t *btree, int value) {
+  int restarts = 0;
+  int rv = 0;
+  while ((rv = olc_try_delete(btree, value)) < 0) {
+    olc_backoff(&restarts);
+  }
+  return rv;
+}
+
+static size_t count_nodes(btree_node_t *node) {
+  if (node == NULL) {
+    return 0;
+  }
+  return 1 + count_nodes(node->left) + count_nodes(node->right);
+}
+
+// smaller values are on the right, so right, node, left is ascending
+static size_t collect_values(btree_node_t *node, int *values, size_t next) {
+  if (node == NULL) {
+    return next;
+  }
+  next = collect_values(node->right, values, next);
+  values[next++] = node->value;
+  return collect_values(node->left, values, next);
+}
+
+// a read-only copy of the tree to search without locks, the tree itself
+// must not change while it is copied
+void freeze_tree(btree_node_t *root, eytzinger_t *frozen) {
+  size_t count = count_nodes(root);
+  int *values = NULL;
+  if ((values = malloc(count * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  collect_values(root, values, 0);
+  eytzinger_build(frozen, values, count);
+  free(values);
+}
+
+// the node holding sorted[i] is always arena[i], so a subtree's root is
+// known before anyone builds it and subtrees can be built in any order
+static btree_node_t *bulk_node(btree_node_t *arena, size_t lo, size_t hi) {
+  return lo < hi ? &arena[lo + (hi - lo) / 2] : NULL;
+}
+
+static void bulk_init_node(btree_node_t *arena, const int *sorted, size_t lo, size_t hi) {
+  size_t mid = lo + (hi - lo) / 2;
+  btree_node_t *node = &arena[mid];
+  node->value = sorted[mid];
+  // larger values go left
+  node->left = bulk_node(arena, mid + 1, hi);
+  node->right = bulk_node(arena, lo, mid);
+  atomic_init(&node->version, 0);
+}
+
+static void bulk_build(btree_node_t *arena, const int *sorted, size_t lo, size_t hi) {
+  if (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    bulk_init_node(arena, sorted, lo, hi);
+    bulk_build(arena, sorted, mid + 1, hi);
+    bulk_build(arena, sorted, lo, mid);
+  }
+}
+
+static void *bulk_build_routine(void *args) {
+  bulk_args_t *a = (bulk_args_t *) args;
+  bulk_build(a->arena, a->sorted, a->lo, a->hi);
+  return NULL;
+}
+
+// the top levels of the tree, stopping where the subtrees are left to
+// the workers and collecting their ranges in tasks
+static void bulk_build_top(btree_node_t *arena, const int *sorted, size_t lo, size_t hi, int depth, bulk_args_t *tasks, int *task_count) {
+  if (lo >= hi) {
+    return;
+  }
+  if (depth == 0) {
+    tasks[*task_count] = (bulk_args_t) { arena, sorted, lo, hi };
+    (*task_count)++;
+    return;
+  }
+  size_t mid = lo + (hi - lo) / 2;
+  bulk_init_node(arena, sorted, lo, hi);
+  bulk_build_top(arena, sorted, mid + 1, hi, depth - 1, tasks, task_count);
+  bulk_build_top(arena, sorted, lo, mid, depth - 1, tasks, task_count);
+}
+
+// sorts the keys on threads workers of pool, drops duplicates and builds a
+// balanced tree in one contiguous arena with a subtree per worker. the
+// arena is never freed, the same as nodes removed by olc_delete
+void bulk_load(btree_root_t *btree, const int *keys, size_t count, worker_pool_t *pool, int threads) {
+  int *sorted = NULL;
+  btree_node_t *arena = NULL;
+  if (count == 0) {
+    fprintf(stderr, "Error bulk loading an empty tree\n");
+    exit(EXIT_FAILURE);
+  }
+  if ((sorted = malloc(count * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(sorted, keys, count * sizeof(int));
+  parallel_sort(pool, threads, sorted, count);
+
+  size_t unique = 1;
+  for (size_t i = 1; i < count; i++) {
+    if (sorted[i] != sorted[unique - 1]) {
+      sorted[unique++] = sorted[i];
     }
   }
+
+  if ((arena = malloc(unique * sizeof(btree_node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // enough levels that there is at least one subtree per worker
+  int depth = 0;
+  while ((1 << depth) < threads) {
+    depth++;
+  }
+  bulk_args_t *tasks = NULL;
+  if ((tasks = malloc((1 << depth) * sizeof(bulk_args_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  int task_count = 0;
+  bulk_build_top(arena, sorted, 0, unique, depth, tasks, &task_count);
+  // every pass gives each worker one subtree
+  for (int done = 0; done < task_count; done += threads) {
+    int n = task_count - done < threads ? task_count - done : threads;
+    pool_run(pool, n, bulk_build_routine, tasks + done, sizeof(bulk_args_t));
+  }
+
+  btree->root = bulk_node(arena, 0, unique);
+  lock_init(&btree->root_lock, lock_default_kind());
+  free(tasks);
+  free(sorted);
+}
+
+// preorder, so a node's left child is next to it in the file
+static uint32_t flatten_tree(btree_node_t *node, tree_file_node_t *nodes, uint32_t *next) {
+  if (node == NULL) {
+    return 0;
+  }
+  uint32_t index = (*next)++;
+  nodes[index].key = node->value;
+  nodes[index].left = flatten_tree(node->left, nodes, next);
+  nodes[index].right = flatten_tree(node->right, nodes, next);
+  return index;
+}
+
+// the tree must not change while it is saved
+void save_tree(btree_node_t *root, const char *path) {
+  size_t count = count_nodes(root);
+  tree_file_node_t *nodes = NULL;
+  if ((nodes = malloc((count + 1) * sizeof(tree_file_node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  uint32_t next = 1;
+  uint32_t root_index = flatten_tree(root, nodes, &next);
+  tree_file_save(path, nodes, count, root_index);
+  free(nodes);
+}
+
+static size_t tree_memory(btree_node_t *node) {
+  if (node == NULL) {
+    return 0;
+  }
+  return sizeof(btree_node_t) + tree_memory(node->left) + tree_memory(node->right);
 }
 
 static void print_in_order(btree_node_t *node) {
   if (node->left != NULL) {
     print_in_order(node->left);
   }
-  fprintf(stdout, "%i %i\n", node->value, node->visited);
+  fprintf(stdout, "%i %i\n", node->value, node_visits(node));
   if (node->right != NULL) {
     print_in_order(node->right);
   }
@@ -130,9 +747,9 @@ void *single_lock_contains(void *args) {
   
   clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
   
-  pthread_mutex_lock(&a->btree->root_lock);
+  lock_acquire(&a->btree->root_lock);
   contains(a->btree->root, a->target_value);
-  pthread_mutex_unlock(&a->btree->root_lock);
+  lock_release(&a->btree->root_lock);
   
   clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
   
@@ -143,13 +760,15 @@ void *single_lock_contains(void *args) {
   return NULL;
 }
 
-void *multi_lock_contains(void *args) {
+void *visit_counting_contains(void *args) {
   args_t *a = (args_t *) args;
   timespec_t t1, t2;
   
+  // each thread is new, set its table up first so only counting is timed
+  reserve_visits(a->path_length);
   clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
 
-  contains_with_lock(a->btree->root, a->target_value);
+  contains_with_visits(a->btree->root, a->target_value);
 
   clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
 
@@ -160,6 +779,394 @@ void *multi_lock_contains(void *args) {
   return NULL;
 }
 
+// single lock or lock coupling depending on how the b-tree was set up
+void *b_tree_contains(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+
+  btree_contains(a->b_tree, a->target_value);
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+
+  pthread_mutex_lock(&a->iter_lock);
+  a->search_times[a->iter++] = elapsed_nsecs(&t1, &t2);
+  pthread_mutex_unlock(&a->iter_lock);
+
+  return NULL;
+}
+
+void *compact_tree_contains(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+
+  compact_contains(a->compact_tree, a->target_value);
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+
+  pthread_mutex_lock(&a->iter_lock);
+  a->search_times[a->iter++] = elapsed_nsecs(&t1, &t2);
+  pthread_mutex_unlock(&a->iter_lock);
+
+  return NULL;
+}
+
+void *mixed_start_routine(void *args) {
+  mixed_args_t *a = (mixed_args_t *) args;
+  for (int i = 0; i < a->count; i++) {
+    int value = rand_r(&a->seed) % NODE_COUNT;
+    int op = rand_r(&a->seed) % 100;
+    if (a->mode == MIXED_LOCK_FREE) {
+      if (op < MIXED_READ_PERCENT) {
+        nm_contains(a->nm_tree, value);
+      } else if (op % 2 == 0) {
+        nm_insert(a->nm_tree, value);
+      } else {
+        nm_delete(a->nm_tree, value);
+      }
+      continue;
+    }
+    if (a->mode == MIXED_SINGLE_LOCK) {
+      lock_acquire(&a->btree->root_lock);
+    }
+    if (op < MIXED_READ_PERCENT) {
+      olc_contains(a->btree, value);
+    } else if (op % 2 == 0) {
+      olc_insert(a->btree, value);
+    } else {
+      olc_delete(a->btree, value);
+    }
+    if (a->mode == MIXED_SINGLE_LOCK) {
+      lock_release(&a->btree->root_lock);
+    }
+  }
+  return NULL;
+}
+
+// MIXED_READ_PERCENT lookups on a tree of MIXED_NODE_COUNT random keys,
+// from 1 to THREAD_COUNT threads
+static void run_mixed_benchmark(void) {
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+  static mixed_args_t args[THREAD_COUNT];
+
+  for (int mode = 0; mode < MIXED_MODES; mode++) {
+    for (int threads = 1; threads <= THREAD_COUNT; threads *= 2) {
+      btree_root_t btree;
+      nm_tree_t nm_tree;
+      init_btree(&btree, INT_MIN);
+      nm_tree_init(&nm_tree);
+      for (int i = 0; i < MIXED_NODE_COUNT; i++) {
+        if (mode == MIXED_LOCK_FREE) {
+          nm_insert(&nm_tree, arc4random_uniform(NODE_COUNT));
+        } else {
+          olc_insert(&btree, arc4random_uniform(NODE_COUNT));
+        }
+      }
+
+      for (int i = 0; i < threads; i++) {
+        args[i].mode = mode;
+        args[i].btree = &btree;
+        args[i].nm_tree = &nm_tree;
+        args[i].seed = i;
+        args[i].count = MIXED_OPS / threads;
+      }
+      uint64_t elapsed = pool_run(&pool, threads, mixed_start_routine, args, sizeof(mixed_args_t));
+      double ops_per_sec = (double) (MIXED_OPS / threads) * threads * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-8s threads: %3d ops/sec: %.0f\n", mixed_mode_names[mode], threads, ops_per_sec);
+    }
+  }
+
+  pool_destroy(&pool);
+}
+
+void *lock_free_contains(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+
+  nm_contains(a->nm_tree, a->target_value);
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+
+  pthread_mutex_lock(&a->iter_lock);
+  a->search_times[a->iter++] = elapsed_nsecs(&t1, &t2);
+  pthread_mutex_unlock(&a->iter_lock);
+
+  return NULL;
+}
+
+// BATCH_LOOKUPS random keys on a NODE_COUNT tree, with contains and then
+// with contains_batch BATCH_SIZE keys at a time
+static void run_batch_benchmark(void) {
+  btree_root_t btree;
+  init_btree(&btree, arc4random_uniform(NODE_COUNT));
+  for (int i = 1; i < NODE_COUNT; i++) {
+    insert_node(btree.root, arc4random_uniform(NODE_COUNT));
+  }
+
+  int *keys = NULL;
+  int *found = NULL;
+  int *batch_found = NULL;
+  if ((keys = malloc(BATCH_LOOKUPS * sizeof(int))) == NULL ||
+      (found = malloc(BATCH_LOOKUPS * sizeof(int))) == NULL ||
+      (batch_found = malloc(BATCH_LOOKUPS * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < BATCH_LOOKUPS; i++) {
+    keys[i] = arc4random_uniform(NODE_COUNT);
+  }
+
+  timespec_t t1, t2;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < BATCH_LOOKUPS; i++) {
+    found[i] = contains(btree.root, keys[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t single = elapsed_nsecs(&t1, &t2);
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < BATCH_LOOKUPS; i += BATCH_SIZE) {
+    int n = BATCH_LOOKUPS - i < BATCH_SIZE ? BATCH_LOOKUPS - i : BATCH_SIZE;
+    contains_batch(btree.root, &keys[i], n, &batch_found[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t batched = elapsed_nsecs(&t1, &t2);
+
+  for (int i = 0; i < BATCH_LOOKUPS; i++) {
+    if (found[i] != batch_found[i]) {
+      fprintf(stderr, "Error contains_batch says %d for %d, contains says %d\n", batch_found[i], keys[i], found[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  fprintf(stdout, "contains average time: %lluns\n", single / BATCH_LOOKUPS);
+  fprintf(stdout, "contains_batch average time: %lluns\n", batched / BATCH_LOOKUPS);
+
+  free(keys);
+  free(found);
+  free(batch_found);
+}
+
+// FREEZE_LOOKUPS random keys on a tree of node_count random keys, with
+// contains and then on the frozen copy. the tree is built with bulk_load,
+// one insert_node per key takes far too long at 100M
+static void run_freeze_benchmark(int node_count) {
+  worker_pool_t pool;
+  pool_init(&pool, BULK_THREADS);
+  int *keys = NULL;
+  if ((keys = malloc(node_count * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < node_count; i++) {
+    keys[i] = arc4random_uniform(node_count);
+  }
+  btree_root_t btree;
+  bulk_load(&btree, keys, node_count, &pool, BULK_THREADS);
+  free(keys);
+  pool_destroy(&pool);
+
+  timespec_t t1, t2;
+  eytzinger_t frozen;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  freeze_tree(btree.root, &frozen);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t freeze_time = elapsed_nsecs(&t1, &t2);
+
+  if ((keys = malloc(FREEZE_LOOKUPS * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < FREEZE_LOOKUPS; i++) {
+    keys[i] = arc4random_uniform(node_count);
+  }
+
+  int found = 0;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < FREEZE_LOOKUPS; i++) {
+    found += contains(btree.root, keys[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t tree_time = elapsed_nsecs(&t1, &t2);
+
+  int frozen_found = 0;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < FREEZE_LOOKUPS; i++) {
+    frozen_found += eytzinger_contains(&frozen, keys[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t frozen_time = elapsed_nsecs(&t1, &t2);
+
+  if (found != frozen_found) {
+    fprintf(stderr, "Error frozen tree found %d keys, tree found %d\n", frozen_found, found);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(stdout, "keys: %d freeze time: %lluns\n", node_count, freeze_time);
+  fprintf(stdout, "keys: %d contains average time: %lluns\n", node_count, tree_time / FREEZE_LOOKUPS);
+  fprintf(stdout, "keys: %d frozen average time: %lluns\n", node_count, frozen_time / FREEZE_LOOKUPS);
+
+  free(keys);
+  eytzinger_destroy(&frozen);
+}
+
+// node_count random keys, built one insert_node at a time and then with
+// bulk_load on 1, 2, 4 ... BULK_THREADS threads. the frozen copy is
+// built from the same parallel sort
+static void run_bulk_benchmark(int node_count) {
+  worker_pool_t pool;
+  pool_init(&pool, BULK_THREADS);
+
+  int *keys = NULL;
+  int *sorted = NULL;
+  if ((keys = malloc(node_count * sizeof(int))) == NULL ||
+      (sorted = malloc(node_count * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < node_count; i++) {
+    keys[i] = arc4random_uniform(node_count);
+  }
+
+  timespec_t t1, t2;
+  btree_root_t inserted;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  init_btree(&inserted, keys[0]);
+  for (int i = 1; i < node_count; i++) {
+    insert_node(inserted.root, keys[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  fprintf(stdout, "keys: %d insert_node time: %lluns\n", node_count, elapsed_nsecs(&t1, &t2));
+
+  for (int threads = 1; threads <= BULK_THREADS; threads *= 2) {
+    btree_root_t loaded;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+    bulk_load(&loaded, keys, node_count, &pool, threads);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+    uint64_t load_time = elapsed_nsecs(&t1, &t2);
+
+    eytzinger_t frozen;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+    memcpy(sorted, keys, node_count * sizeof(int));
+    parallel_sort(&pool, threads, sorted, node_count);
+    eytzinger_build(&frozen, sorted, node_count);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+    uint64_t frozen_time = elapsed_nsecs(&t1, &t2);
+
+    for (int i = 0; i < node_count; i += node_count / 1000 + 1) {
+      int key = arc4random_uniform(node_count);
+      int found = contains(inserted.root, key);
+      if (contains(loaded.root, key) != found || eytzinger_contains(&frozen, key) != found) {
+        fprintf(stderr, "Error bulk loaded trees disagree on %d\n", key);
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    fprintf(stdout, "keys: %d threads: %2d bulk_load time: %lluns eytzinger time: %lluns\n",
+      node_count, threads, load_time, frozen_time);
+    eytzinger_destroy(&frozen);
+  }
+
+  free(sorted);
+  free(keys);
+  pool_destroy(&pool);
+}
+
+// write path back to disk and drop it from the page cache, so mapping it
+// next starts cold. only a hint, and not there on every platform
+static void evict_file(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  fsync(fd);
+#if defined(POSIX_FADV_DONTNEED)
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  close(fd);
+}
+
+// time from nothing to the first answer, building a NODE_COUNT tree with
+// insert_node and then mapping the same tree saved to path, followed by
+// SNAPSHOT_LOOKUPS lookups on each
+static void run_snapshot_benchmark(const char *path) {
+  timespec_t t1, t2;
+  int first_key = arc4random_uniform(NODE_COUNT);
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  btree_root_t btree;
+  init_btree(&btree, arc4random_uniform(NODE_COUNT));
+  for (int i = 1; i < NODE_COUNT; i++) {
+    insert_node(btree.root, arc4random_uniform(NODE_COUNT));
+  }
+  int found = contains(btree.root, first_key);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t rebuild_time = elapsed_nsecs(&t1, &t2);
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  save_tree(btree.root, path);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t save_time = elapsed_nsecs(&t1, &t2);
+  evict_file(path);
+
+  tree_file_t file;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  tree_file_open(&file, path);
+  int file_found = tree_file_contains(&file, first_key);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t map_time = elapsed_nsecs(&t1, &t2);
+
+  if (found != file_found) {
+    fprintf(stderr, "Error snapshot found %d for %d, tree found %d\n", file_found, first_key, found);
+    exit(EXIT_FAILURE);
+  }
+
+  int *keys = NULL;
+  if ((keys = malloc(SNAPSHOT_LOOKUPS * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < SNAPSHOT_LOOKUPS; i++) {
+    keys[i] = arc4random_uniform(NODE_COUNT);
+  }
+
+  found = 0;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < SNAPSHOT_LOOKUPS; i++) {
+    found += contains(btree.root, keys[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t tree_time = elapsed_nsecs(&t1, &t2);
+
+  file_found = 0;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < SNAPSHOT_LOOKUPS; i++) {
+    file_found += tree_file_contains(&file, keys[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  uint64_t file_time = elapsed_nsecs(&t1, &t2);
+
+  if (found != file_found) {
+    fprintf(stderr, "Error snapshot found %d keys, tree found %d\n", file_found, found);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(stdout, "Rebuild time to first lookup: %lluns\n", rebuild_time);
+  fprintf(stdout, "Snapshot save time: %lluns (%zu bytes)\n", save_time, file.size);
+  fprintf(stdout, "Snapshot time to first lookup: %lluns\n", map_time);
+  fprintf(stdout, "contains average time: %lluns\n", tree_time / SNAPSHOT_LOOKUPS);
+  fprintf(stdout, "Snapshot average time: %lluns\n", file_time / SNAPSHOT_LOOKUPS);
+
+  free(keys);
+  tree_file_close(&file);
+}
+
 int find_greatest_value(btree_node_t *node) {
   btree_node_t *cur = node;
   int greatest = 0;
@@ -172,7 +1179,48 @@ int find_greatest_value(btree_node_t *node) {
   return greatest;
 }
 
-int main(void) {
+// nodes contains passes through looking for value, the last one included
+int path_length(btree_node_t *node, int value) {
+  int length = 0;
+  while (node != NULL) {
+    length++;
+    if (node->value == value) {
+      break;
+    }
+    node = node->value < value ? node->left : node->right;
+  }
+  return length;
+}
+
+int main(int argc, char **argv) {
+  fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+
+  if (argc > 1 && strcmp(argv[1], "mixed") == 0) {
+    run_mixed_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+    run_batch_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "freeze") == 0) {
+    if (argc > 2) {
+      run_freeze_benchmark(atoi(argv[2]));
+    } else {
+      run_freeze_benchmark(NODE_COUNT);
+      run_freeze_benchmark(100 * NODE_COUNT);
+    }
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "snapshot") == 0) {
+    run_snapshot_benchmark(argc > 2 ? argv[2] : SNAPSHOT_FILE);
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "bulk") == 0) {
+    run_bulk_benchmark(argc > 2 ? atoi(argv[2]) : NODE_COUNT);
+    return EXIT_SUCCESS;
+  }
+
   btree_root_t btree;
   int rv = 0;
   init_btree(&btree, arc4random_uniform(NODE_COUNT));
@@ -181,9 +1229,29 @@ int main(void) {
   pthread_t threads[THREAD_COUNT];
   uint64_t search_times1[THREAD_COUNT] = { 0 };
   uint64_t search_times2[THREAD_COUNT] = { 0 };
+  uint64_t search_times3[THREAD_COUNT] = { 0 };
+  uint64_t search_times4[THREAD_COUNT] = { 0 };
+  uint64_t search_times5[THREAD_COUNT] = { 0 };
+  uint64_t search_times6[THREAD_COUNT] = { 0 };
+
+  // the same keys in a b-tree with each locking strategy
+  btree_t single_b_tree;
+  btree_t coupled_b_tree;
+  btree_init(&single_b_tree, BTREE_SINGLE_LOCK, lock_default_kind());
+  btree_init(&coupled_b_tree, BTREE_NODE_LOCKS, lock_default_kind());
+  btree_insert(&single_b_tree, btree.root->value);
+  btree_insert(&coupled_b_tree, btree.root->value);
+  nm_tree_t nm_tree;
+  nm_tree_init(&nm_tree);
+  nm_insert(&nm_tree, btree.root->value);
+  compact_tree_t compact_tree;
+  compact_tree_init(&compact_tree, NODE_COUNT, lock_default_kind());
+  compact_insert(&compact_tree, btree.root->value);
 
   args_t args = { 0 };
   args.btree = &btree;
+  args.nm_tree = &nm_tree;
+  args.compact_tree = &compact_tree;
   args.iter = 0;
   pthread_mutex_init(&args.iter_lock, NULL);
   args.search_times = search_times1;
@@ -191,10 +1259,15 @@ int main(void) {
   for (int i = 1; i < NODE_COUNT; i++) {
     int k = arc4random_uniform(NODE_COUNT);
     insert_node(btree.root, k);
+    btree_insert(&single_b_tree, k);
+    btree_insert(&coupled_b_tree, k);
+    nm_insert(&nm_tree, k);
+    compact_insert(&compact_tree, k);
   }
 
   int target_value = find_greatest_value(btree.root);
   args.target_value = target_value;
+  args.path_length = path_length(btree.root, target_value);
 
   for (int i = 0; i < THREAD_COUNT; i++) {
     if ((rv = pthread_create(&threads[i], NULL, single_lock_contains, &args) != 0)) {
@@ -212,7 +1285,7 @@ int main(void) {
   args.search_times = search_times2;
 
   for (int i = 0; i < THREAD_COUNT; i++) {
-    if ((rv = pthread_create(&threads[i], NULL, multi_lock_contains, &args) != 0)) {
+    if ((rv = pthread_create(&threads[i], NULL, visit_counting_contains, &args) != 0)) {
       fprintf(stdout, "pthread_create err: %i: %s\n" , rv, strerror(rv));
     }
   }
@@ -223,8 +1296,65 @@ int main(void) {
     }
   }
   
+  btree_t *b_trees[] = { &single_b_tree, &coupled_b_tree };
+  uint64_t *b_tree_times[] = { search_times3, search_times4 };
+  for (int b = 0; b < 2; b++) {
+    args.iter = 0;
+    args.search_times = b_tree_times[b];
+    args.b_tree = b_trees[b];
+
+    for (int i = 0; i < THREAD_COUNT; i++) {
+      if ((rv = pthread_create(&threads[i], NULL, b_tree_contains, &args) != 0)) {
+        fprintf(stdout, "pthread_create err: %i: %s\n" , rv, strerror(rv));
+      }
+    }
+
+    for (int i = 0; i < THREAD_COUNT; i++) {
+      if ((rv = pthread_join(threads[i], NULL)) != 0) {
+        fprintf(stdout, "pthread_join err: %i: %s\n" , rv, strerror(rv));
+      }
+    }
+  }
+
+  args.iter = 0;
+  args.search_times = search_times5;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    if ((rv = pthread_create(&threads[i], NULL, lock_free_contains, &args) != 0)) {
+      fprintf(stdout, "pthread_create err: %i: %s\n" , rv, strerror(rv));
+    }
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    if ((rv = pthread_join(threads[i], NULL)) != 0) {
+      fprintf(stdout, "pthread_join err: %i: %s\n" , rv, strerror(rv));
+    }
+  }
+
+  args.iter = 0;
+  args.search_times = search_times6;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    if ((rv = pthread_create(&threads[i], NULL, compact_tree_contains, &args) != 0)) {
+      fprintf(stdout, "pthread_create err: %i: %s\n" , rv, strerror(rv));
+    }
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    if ((rv = pthread_join(threads[i], NULL)) != 0) {
+      fprintf(stdout, "pthread_join err: %i: %s\n" , rv, strerror(rv));
+    }
+  }
+
   // print_in_order(btree.root);
 
   fprintf(stdout, "Single lock average time: %lluns\n", average_cost(search_times1, THREAD_COUNT));
-  fprintf(stdout, "Multiple lock average time: %lluns\n", average_cost(search_times2, THREAD_COUNT));
+  fprintf(stdout, "Counting visits average time: %lluns\n", average_cost(search_times2, THREAD_COUNT));
+  fprintf(stdout, "B-tree single lock average time: %lluns\n", average_cost(search_times3, THREAD_COUNT));
+  fprintf(stdout, "B-tree lock coupling average time: %lluns\n", average_cost(search_times4, THREAD_COUNT));
+  fprintf(stdout, "Lock-free tree average time: %lluns\n", average_cost(search_times5, THREAD_COUNT));
+  fprintf(stdout, "Compact tree average time: %lluns\n", average_cost(search_times6, THREAD_COUNT));
+  fprintf(stdout, "Binary tree memory: %zu bytes\n", tree_memory(btree.root));
+  fprintf(stdout, "B-tree memory: %zu bytes\n", btree_memory(&single_b_tree));
+  fprintf(stdout, "Compact tree memory: %zu bytes\n", compact_tree_memory(&compact_tree));
 }
@@ -0,0 +1,220 @@
+/*
+  B-tree [BM72] with nodes sized to cache lines, inserting top down so
+  any full node on the way is split before we go below it [CLRS, ch. 18].
+  That means an insert never has to go back up, so with node locks it
+  only ever holds a node and its child, the same as a lookup.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "btree.h"
+
+static bnode_t *create_node(btree_t *tree, int leaf) {
+  bnode_t *node = NULL;
+  if ((node = aligned_alloc(CACHE_LINE_SIZE, sizeof(bnode_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i <= BTREE_MAX_KEYS; i++) {
+    node->keys[i] = INT_MAX;
+    node->children[i] = NULL;
+  }
+  node->count = 0;
+  node->leaf = leaf;
+  lock_init(&node->lock, tree->kind);
+  return node;
+}
+
+// number of keys less than key, which is both where key would go and the
+// child to follow. padding is INT_MAX so it never counts
+static int node_rank(const bnode_t *node, int key) {
+#if defined(__SSE2__)
+  __m128i needle = _mm_set1_epi32(key);
+  int rank = 0;
+  for (int i = 0; i <= BTREE_MAX_KEYS; i += 4) {
+    __m128i keys = _mm_load_si128((const __m128i *) &node->keys[i]);
+    rank += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(keys, needle))));
+  }
+  return rank;
+#else
+  int lo = 0;
+  int hi = node->count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (node->keys[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+#endif
+}
+
+// move the top half of the full child at index i into a new sibling and
+// its median up into parent, which has room. caller holds both locks,
+// the sibling isn't reachable until parent's lock is released
+static void split_child(btree_t *tree, bnode_t *parent, int i) {
+  bnode_t *child = parent->children[i];
+  bnode_t *sibling = create_node(tree, child->leaf);
+  int t = BTREE_MIN_DEGREE;
+  for (int j = 0; j < t - 1; j++) {
+    sibling->keys[j] = child->keys[j + t];
+    child->keys[j + t] = INT_MAX;
+  }
+  if (!child->leaf) {
+    for (int j = 0; j < t; j++) {
+      sibling->children[j] = child->children[j + t];
+      child->children[j + t] = NULL;
+    }
+  }
+  sibling->count = t - 1;
+  int median = child->keys[t - 1];
+  child->keys[t - 1] = INT_MAX;
+  child->count = t - 1;
+
+  for (int j = parent->count; j > i; j--) {
+    parent->keys[j] = parent->keys[j - 1];
+    parent->children[j + 1] = parent->children[j];
+  }
+  parent->keys[i] = median;
+  parent->children[i + 1] = sibling;
+  parent->count++;
+}
+
+void btree_init(btree_t *tree, btree_mode_t mode, lock_kind_t kind) {
+  tree->mode = mode;
+  tree->kind = kind;
+  lock_init(&tree->lock, kind);
+  tree->root = create_node(tree, 1);
+}
+
+// node is locked and not full, and is unlocked by the time we return
+static int insert_from(btree_t *tree, bnode_t *node, int key) {
+  int locks = tree->mode == BTREE_NODE_LOCKS;
+  for (;;) {
+    int i = node_rank(node, key);
+    if (i < node->count && node->keys[i] == key) {
+      break;
+    }
+    if (node->leaf) {
+      for (int j = node->count; j > i; j--) {
+        node->keys[j] = node->keys[j - 1];
+      }
+      node->keys[i] = key;
+      node->count++;
+      if (locks) {
+        lock_release(&node->lock);
+      }
+      return 0;
+    }
+    bnode_t *child = node->children[i];
+    if (locks) {
+      lock_acquire(&child->lock);
+    }
+    if (child->count == BTREE_MAX_KEYS) {
+      split_child(tree, node, i);
+      if (node->keys[i] == key) {
+        if (locks) {
+          lock_release(&child->lock);
+        }
+        break;
+      }
+      if (node->keys[i] < key) {
+        if (locks) {
+          lock_release(&child->lock);
+        }
+        child = node->children[i + 1];
+        if (locks) {
+          lock_acquire(&child->lock);
+        }
+      }
+    }
+    if (locks) {
+      lock_release(&node->lock);
+    }
+    node = child;
+  }
+  if (locks) {
+    lock_release(&node->lock);
+  }
+  return -1;
+}
+
+int btree_insert(btree_t *tree, int key) {
+  int locks = tree->mode == BTREE_NODE_LOCKS;
+  lock_acquire(&tree->lock);
+  bnode_t *root = tree->root;
+  if (locks) {
+    lock_acquire(&root->lock);
+  }
+  // the tree only grows here, a new root above the split old one
+  if (root->count == BTREE_MAX_KEYS) {
+    bnode_t *new_root = create_node(tree, 0);
+    new_root->children[0] = root;
+    split_child(tree, new_root, 0);
+    if (locks) {
+      lock_acquire(&new_root->lock);
+      lock_release(&root->lock);
+    }
+    tree->root = new_root;
+    root = new_root;
+  }
+  if (!locks) {
+    int rv = insert_from(tree, root, key);
+    lock_release(&tree->lock);
+    return rv;
+  }
+  lock_release(&tree->lock);
+  return insert_from(tree, root, key);
+}
+
+int btree_contains(btree_t *tree, int key) {
+  int locks = tree->mode == BTREE_NODE_LOCKS;
+  int rv = 0;
+  lock_acquire(&tree->lock);
+  bnode_t *node = tree->root;
+  if (locks) {
+    lock_acquire(&node->lock);
+    lock_release(&tree->lock);
+  }
+  for (;;) {
+    int i = node_rank(node, key);
+    if (i < node->count && node->keys[i] == key) {
+      rv = 1;
+      break;
+    }
+    if (node->leaf) {
+      break;
+    }
+    bnode_t *child = node->children[i];
+    if (locks) {
+      lock_acquire(&child->lock);
+      lock_release(&node->lock);
+    }
+    node = child;
+  }
+  lock_release(locks ? &node->lock : &tree->lock);
+  return rv;
+}
+
+static size_t node_memory(bnode_t *node) {
+  size_t bytes = sizeof(bnode_t);
+  if (!node->leaf) {
+    for (int i = 0; i <= node->count; i++) {
+      bytes += node_memory(node->children[i]);
+    }
+  }
+  return bytes;
+}
+
+size_t btree_memory(btree_t *tree) {
+  lock_acquire(&tree->lock);
+  size_t bytes = node_memory(tree->root);
+  lock_release(&tree->lock);
+  return bytes;
+}
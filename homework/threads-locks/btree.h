@@ -0,0 +1,44 @@
+#ifndef BTREE_H_
+#define BTREE_H_
+
+#include <stddef.h>
+#include "lock.h"
+
+// every node but the root holds between BTREE_MIN_DEGREE - 1 and
+// BTREE_MAX_KEYS keys. the default keeps a node's keys in one cache line,
+// keep it even so the keys can be compared four at a time
+#ifndef BTREE_MIN_DEGREE
+#define BTREE_MIN_DEGREE 8
+#endif
+#define BTREE_MAX_KEYS (2 * BTREE_MIN_DEGREE - 1)
+
+typedef enum btree_mode_t {
+  BTREE_SINGLE_LOCK, // every operation holds the tree lock throughout
+  BTREE_NODE_LOCKS,  // lock coupling from the root down, inserts split full nodes on the way
+} btree_mode_t;
+
+typedef struct bnode_t {
+  // INT_MAX past count, so a search can compare every slot
+  _Alignas(CACHE_LINE_SIZE) int keys[BTREE_MAX_KEYS + 1];
+  int count;
+  int leaf;
+  lock_t lock;
+  struct bnode_t *children[BTREE_MAX_KEYS + 1];
+} bnode_t;
+
+typedef struct btree_t {
+  bnode_t *root;
+  lock_t lock;
+  btree_mode_t mode;
+  lock_kind_t kind;
+} btree_t;
+
+void btree_init(btree_t *tree, btree_mode_t mode, lock_kind_t kind);
+// 0 once key is in the tree, -1 if it already was
+int btree_insert(btree_t *tree, int key);
+// 1 if key is in the tree, 0 otherwise
+int btree_contains(btree_t *tree, int key);
+// bytes used by every node, not counting the allocator's own overhead
+size_t btree_memory(btree_t *tree);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  Binary search tree with 12 byte nodes. Children are 32-bit indexes
+  into one array instead of pointers, and the locks are kept out of the
+  nodes altogether in a table of COMPACT_STRIPES locks that every node
+  shares, see stripe.c. A million nodes take 12MB plus the fixed lock table,
+  where a node with its own mutex and two pointers is 80 bytes.
+
+  Operations couple locks from the root down the same as a tree with a
+  lock per node. Only the root's stripe is ever waited for, every stripe
+  below it is tried, and if one is busy the operation lets go of what it
+  holds and starts again from the root.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "compact_tree.h"
+
+static lock_t *stripe(compact_tree_t *tree, uint32_t index) {
+  return stripe_lock(&tree->stripes, &tree->nodes[index]);
+}
+
+void compact_tree_init(compact_tree_t *tree, uint32_t capacity, lock_kind_t kind) {
+  if ((tree->nodes = malloc(((size_t) capacity + 1) * sizeof(compact_node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  tree->capacity = capacity;
+  atomic_init(&tree->count, 1);
+  tree->root = 0;
+  lock_init(&tree->root_lock, kind);
+  stripes_init(&tree->stripes, COMPACT_STRIPES, kind);
+}
+
+static uint32_t create_node(compact_tree_t *tree, int key) {
+  uint32_t index = atomic_fetch_add_explicit(&tree->count, 1, memory_order_relaxed);
+  if (index > tree->capacity) {
+    fprintf(stderr, "Error compact tree is full at %u keys\n", tree->capacity);
+    exit(EXIT_FAILURE);
+  }
+  compact_node_t *node = &tree->nodes[index];
+  node->key = key;
+  node->left = 0;
+  node->right = 0;
+  return index;
+}
+
+// returns the index of the node holding key, or the node it would go
+// under with its stripe still held. -1 if a stripe was busy and the
+// caller has to start again, with nothing held. tree->root is not 0
+static int64_t find(compact_tree_t *tree, int key, int *found) {
+  uint32_t index = tree->root;
+  lock_t *held = stripe(tree, index);
+  lock_acquire(held);
+  lock_release(&tree->root_lock);
+  for (;;) {
+    compact_node_t *node = &tree->nodes[index];
+    if (node->key == key) {
+      *found = 1;
+      return index;
+    }
+    uint32_t next = node->key < key ? node->left : node->right;
+    if (next == 0) {
+      *found = 0;
+      return index;
+    }
+    if ((held = stripe_couple(&tree->stripes, held, &tree->nodes[next])) == NULL) {
+      return -1;
+    }
+    index = next;
+  }
+}
+
+int compact_insert(compact_tree_t *tree, int key) {
+  for (;;) {
+    lock_acquire(&tree->root_lock);
+    if (tree->root == 0) {
+      tree->root = create_node(tree, key);
+      lock_release(&tree->root_lock);
+      return 0;
+    }
+    int found = 0;
+    int64_t index = find(tree, key, &found);
+    if (index < 0) {
+      continue;
+    }
+    int rv = -1;
+    compact_node_t *node = &tree->nodes[index];
+    if (!found) {
+      uint32_t child = create_node(tree, key);
+      if (node->key < key) {
+        node->left = child;
+      } else {
+        node->right = child;
+      }
+      rv = 0;
+    }
+    lock_release(stripe(tree, index));
+    return rv;
+  }
+}
+
+int compact_contains(compact_tree_t *tree, int key) {
+  for (;;) {
+    lock_acquire(&tree->root_lock);
+    if (tree->root == 0) {
+      lock_release(&tree->root_lock);
+      return 0;
+    }
+    int found = 0;
+    int64_t index = find(tree, key, &found);
+    if (index < 0) {
+      continue;
+    }
+    lock_release(stripe(tree, index));
+    return found;
+  }
+}
+
+size_t compact_tree_memory(compact_tree_t *tree) {
+  return ((size_t) tree->capacity + 1) * sizeof(compact_node_t) + stripes_memory(&tree->stripes);
+}
+
+void compact_tree_destroy(compact_tree_t *tree) {
+  lock_destroy(&tree->root_lock);
+  stripes_destroy(&tree->stripes);
+  free(tree->nodes);
+}
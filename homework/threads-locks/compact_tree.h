@@ -0,0 +1,42 @@
+#ifndef COMPACT_TREE_H_
+#define COMPACT_TREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "lock.h"
+#include "stripe.h"
+
+// nodes share this many locks, keep it a power of two
+#ifndef COMPACT_STRIPES
+#define COMPACT_STRIPES 1024
+#endif
+
+// children are indexes into the tree's node array, 0 is no child.
+// larger keys go left, the same as binary_tree
+typedef struct compact_node_t {
+  int key;
+  uint32_t left;
+  uint32_t right;
+} compact_node_t;
+
+typedef struct compact_tree_t {
+  compact_node_t *nodes;
+  uint32_t capacity;
+  atomic_uint count; // nodes[0] is never handed out
+  uint32_t root;
+  lock_t root_lock;
+  stripes_t stripes;
+} compact_tree_t;
+
+// room for capacity keys, inserting more is an error
+void compact_tree_init(compact_tree_t *tree, uint32_t capacity, lock_kind_t kind);
+// 0 once key is in the tree, -1 if it already was
+int compact_insert(compact_tree_t *tree, int key);
+// 1 if key is in the tree, 0 otherwise
+int compact_contains(compact_tree_t *tree, int key);
+// bytes of the node array and lock table
+size_t compact_tree_memory(compact_tree_t *tree);
+void compact_tree_destroy(compact_tree_t *tree);
+
+#endif
@@ -3,69 +3,172 @@
   takes to increment the counter many times as the number of threads
   increases. How many CPUs are available on the system you are
   using? Does this number impact your measurements at all?
+
+  gcc -o bin/concurrent_counter concurrent_counter.c lock.c worker_pool.c timer.c
+  LOCK_KIND=mcs ./concurrent_counter
+
+  ./concurrent_counter                 every backend from 1 to THREAD_COUNT threads
+  ./concurrent_counter oversubscribe   lock backend at 1x, 4x and 32x the cpu count
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "lock.h"
+#include "timer.h"
+#include "worker_pool.h"
 
 #define THREAD_COUNT 1000
 #define MAX_COUNT 1000000 // 1,000,000
+#define CACHE_LINE_SIZE 64
 #define NSEC_IN_SEC 1000000000 // 1,000,000,000
 
+typedef enum counter_backend_t {
+  LOCK_BACKEND,      // every update takes the lock
+  ATOMIC_BACKEND,    // every update is a single fetch-add
+  COMBINING_BACKEND, // threads publish updates, one combiner applies the batch
+  COUNTER_BACKENDS
+} counter_backend_t;
+
+static const char *counter_backend_names[COUNTER_BACKENDS] = { "lock", "atomic", "combining" };
+
+// a thread's published update, 0 once the combiner has applied it
+typedef struct fc_slot_t {
+  _Alignas(CACHE_LINE_SIZE) atomic_int pending;
+} fc_slot_t;
+
 typedef struct counter_t {
+  counter_backend_t backend;
+  int id;
   int value;
-  pthread_mutex_t lock;
+  lock_t lock;
+  _Alignas(CACHE_LINE_SIZE) atomic_int atomic_value;
+  _Alignas(CACHE_LINE_SIZE) atomic_flag combiner;
+  atomic_int slot_count;
+  fc_slot_t slots[THREAD_COUNT];
 } counter_t;
 
 typedef struct args_t {
   int thread_id;
+  int iterations;
   counter_t *c;
 } args_t;
 
-typedef struct timespec timespec_t;
+static atomic_int next_counter_id = 1;
 
-void init_counter(counter_t *c) {
+// slot this thread publishes to, valid while fc_counter_id matches the counter
+static _Thread_local int fc_counter_id = 0;
+static _Thread_local fc_slot_t *fc_slot = NULL;
+
+void init_counter(counter_t *c, counter_backend_t backend, lock_kind_t kind) {
+  c->backend = backend;
+  c->id = atomic_fetch_add(&next_counter_id, 1);
   c->value = 0;
-  if ((pthread_mutex_init(&c->lock, NULL)) > 0) {
-    fprintf(stderr, "Error initialising mutex\n");
-    exit(EXIT_FAILURE);
+  lock_init(&c->lock, kind);
+  atomic_init(&c->atomic_value, 0);
+  atomic_flag_clear(&c->combiner);
+  atomic_init(&c->slot_count, 0);
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    atomic_init(&c->slots[i].pending, 0);
   }
 }
 
-void increment_counter(counter_t *c) {
-  if ((pthread_mutex_lock(&c->lock)) > 0) {
-    fprintf(stderr, "Error getting mutex\n");
-    exit(EXIT_FAILURE);
+static fc_slot_t *get_fc_slot(counter_t *c) {
+  if (fc_counter_id != c->id) {
+    int slot = atomic_fetch_add(&c->slot_count, 1);
+    if (slot >= THREAD_COUNT) {
+      fprintf(stderr, "Error more than %d threads using combining counter\n", THREAD_COUNT);
+      exit(EXIT_FAILURE);
+    }
+    fc_slot = &c->slots[slot];
+    fc_counter_id = c->id;
+  }
+  return fc_slot;
+}
+
+// apply every published update, caller holds the combiner flag
+static void combine(counter_t *c) {
+  int slot_count = atomic_load_explicit(&c->slot_count, memory_order_acquire);
+  if (slot_count > THREAD_COUNT) {
+    slot_count = THREAD_COUNT;
   }
-  c->value++;
-  if ((pthread_mutex_unlock(&c->lock)) > 0) {
-    fprintf(stderr, "Error releasing mutex\n");
-    exit(EXIT_FAILURE);
+  int sum = 0;
+  for (int i = 0; i < slot_count; i++) {
+    int pending = atomic_load_explicit(&c->slots[i].pending, memory_order_acquire);
+    if (pending != 0) {
+      sum += pending;
+      atomic_store_explicit(&c->slots[i].pending, 0, memory_order_release);
+    }
   }
+  c->value += sum;
 }
 
-void decrement_counter(counter_t *c) {
-  if ((pthread_mutex_lock(&c->lock)) > 0) {
-    fprintf(stderr, "Error getting mutex\n");
-    exit(EXIT_FAILURE);
+static void combining_update(counter_t *c, int amount) {
+  fc_slot_t *slot = get_fc_slot(c);
+  atomic_store_explicit(&slot->pending, amount, memory_order_release);
+  // either become the combiner and apply everyone's updates, or wait
+  // for the current combiner to pick ours up
+  while (atomic_load_explicit(&slot->pending, memory_order_acquire) != 0) {
+    if (!atomic_flag_test_and_set_explicit(&c->combiner, memory_order_acquire)) {
+      combine(c);
+      atomic_flag_clear_explicit(&c->combiner, memory_order_release);
+    } else {
+      sched_yield();
+    }
   }
-  c->value--;
-  if ((pthread_mutex_unlock(&c->lock)) > 0) {
-    fprintf(stderr, "Error releasing mutex\n");
-    exit(EXIT_FAILURE);
+}
+
+static void lock_update(counter_t *c, int amount) {
+  lock_acquire(&c->lock);
+  c->value += amount;
+  lock_release(&c->lock);
+}
+
+static void update_counter(counter_t *c, int amount) {
+  switch (c->backend) {
+    case ATOMIC_BACKEND:
+      atomic_fetch_add_explicit(&c->atomic_value, amount, memory_order_relaxed);
+      break;
+    case COMBINING_BACKEND:
+      combining_update(c, amount);
+      break;
+    default:
+      lock_update(c, amount);
+      break;
   }
 }
 
+void increment_counter(counter_t *c) {
+  update_counter(c, 1);
+}
+
+void decrement_counter(counter_t *c) {
+  update_counter(c, -1);
+}
+
 int get_count(counter_t *c) {
-  if ((pthread_mutex_lock(&c->lock)) > 0) {
-    fprintf(stderr, "Error getting mutex\n");
-    exit(EXIT_FAILURE);
-  }
-  int counter = c->value;
-  if ((pthread_mutex_unlock(&c->lock)) > 0) {
-    fprintf(stderr, "Error getting mutex\n");
-    exit(EXIT_FAILURE);
+  int counter = 0;
+  switch (c->backend) {
+    case ATOMIC_BACKEND:
+      counter = atomic_load_explicit(&c->atomic_value, memory_order_relaxed);
+      break;
+    case COMBINING_BACKEND:
+      while (atomic_flag_test_and_set_explicit(&c->combiner, memory_order_acquire)) {
+        sched_yield();
+      }
+      counter = c->value;
+      atomic_flag_clear_explicit(&c->combiner, memory_order_release);
+      break;
+    default:
+      lock_acquire(&c->lock);
+      counter = c->value;
+      lock_release(&c->lock);
+      break;
   }
   return counter;
 }
@@ -73,49 +176,83 @@ int get_count(counter_t *c) {
 void *start_routine(void *args) {
   args_t *a = (args_t *) args;
   counter_t *c = (counter_t *) a->c;
-  for (int i = 0; i < (MAX_COUNT / THREAD_COUNT); i++) {
+  for (int i = 0; i < a->iterations; i++) {
     increment_counter((counter_t *) c);
   }
   return NULL;
 }
 
-static uint64_t elapsed_nsecs(timespec_t *start, timespec_t *end) {
-  timespec_t temp = { 0 };
-  // its possible for (end->nsec - start->nsec) to be negative, if so subract 1 full second
-  if ((end->tv_nsec - start->tv_nsec) < 0) {
-    temp.tv_sec = end->tv_sec - start->tv_sec - 1;
-    temp.tv_nsec = NSEC_IN_SEC + end->tv_nsec - start->tv_nsec; // add value of negative nsec
-  } else {
-    temp.tv_sec = end->tv_sec - start->tv_sec;
-    temp.tv_nsec = end->tv_nsec - start->tv_nsec;
+// time thread_count threads sharing MAX_COUNT increments between them,
+// the pool's threads already exist so creating them is not measured
+static uint64_t run_benchmark(worker_pool_t *pool, counter_t *c, int thread_count) {
+  static args_t args[THREAD_COUNT];
+
+  for (int i = 0; i < thread_count; i++) {
+    args[i].c = c;
+    args[i].thread_id = i;
+    args[i].iterations = MAX_COUNT / thread_count;
   }
-  return (temp.tv_sec * NSEC_IN_SEC) + temp.tv_nsec;
-}
 
-int main(void) {
+  return pool_run(pool, thread_count, start_routine, args, sizeof(args_t));
+}
 
-  counter_t c;
-  init_counter(&c);
+// 1, 2, 4 ... threads, always finishing on THREAD_COUNT
+static int next_thread_count(int threads) {
+  if (threads < THREAD_COUNT && threads * 2 > THREAD_COUNT) {
+    return THREAD_COUNT;
+  }
+  return threads * 2;
+}
 
-  args_t args[THREAD_COUNT];
-  pthread_t threads[THREAD_COUNT];
+// the lock backend with 1x, 4x and 32x as many threads as cpus (up to
+// THREAD_COUNT), comparing a pure spinlock, pthread mutex and the futex lock
+static void run_oversubscribe_benchmark(worker_pool_t *pool) {
+  static const lock_kind_t kinds[] = { LOCK_MUTEX, LOCK_TTAS, LOCK_FUTEX };
+  static const int factors[] = { 1, 4, 32 };
+  static counter_t c;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
 
-  timespec_t t1, t2;
+  for (int k = 0; k < (int) (sizeof(kinds) / sizeof(kinds[0])); k++) {
+    for (int f = 0; f < (int) (sizeof(factors) / sizeof(factors[0])); f++) {
+      int threads = cpus * factors[f] < THREAD_COUNT ? cpus * factors[f] : THREAD_COUNT;
+      init_counter(&c, LOCK_BACKEND, kinds[k]);
+      uint64_t elapsed = run_benchmark(pool, &c, threads);
+      double ops_per_sec = (double) get_count(&c) * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-6s %2dx threads: %4d elapsed time: %12llu ops/sec: %.0f\n",
+        lock_kind_name(kinds[k]), factors[f], threads, elapsed, ops_per_sec);
+    }
+  }
+}
 
-  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+int main(int argc, char **argv) {
+  static counter_t c;
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
 
-  for (int i = 0; i < THREAD_COUNT; i++) {
-    args[i].c = &c;
-    args[i].thread_id = i;
-    pthread_create(&threads[i], NULL, start_routine, &args[i]);
+  if (argc > 1 && strcmp(argv[1], "oversubscribe") == 0) {
+    run_oversubscribe_benchmark(&pool);
+    pool_destroy(&pool);
+    return EXIT_SUCCESS;
   }
 
-  for (int i = 0; i < THREAD_COUNT; i++) {
-    pthread_join(threads[i], NULL);
+  fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+
+  for (int backend = 0; backend < COUNTER_BACKENDS; backend++) {
+    for (int threads = 1; threads <= THREAD_COUNT; threads = next_thread_count(threads)) {
+      init_counter(&c, backend, lock_default_kind());
+      uint64_t elapsed = run_benchmark(&pool, &c, threads);
+      int expected = (MAX_COUNT / threads) * threads;
+      if (get_count(&c) != expected) {
+        fprintf(stderr, "Error %s counter is %d, expected %d\n", counter_backend_names[backend], get_count(&c), expected);
+        exit(EXIT_FAILURE);
+      }
+      double ops_per_sec = (double) expected * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-9s threads: %4d elapsed time: %12llu ops/sec: %.0f\n",
+        counter_backend_names[backend], threads, elapsed, ops_per_sec);
+    }
   }
 
-  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
-  fprintf(stdout, "Elapsed time: %llu\n", elapsed_nsecs(&t1, &t2));
+  pool_destroy(&pool);
 
   return EXIT_SUCCESS;
 }
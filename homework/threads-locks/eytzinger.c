@@ -0,0 +1,59 @@
+/*
+  Eytzinger layout search [KM17]. The top levels of the tree share a few
+  cache lines that stay hot. Below that, the descendants of node i four
+  levels down sit together at 16i, so one prefetch brings in a whole line
+  of them while we work through the levels in between. The comparison
+  feeds the index arithmetic directly, so there is no branch to mispredict.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "eytzinger.h"
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+#define KEYS_PER_LINE ((size_t) (CACHE_LINE_SIZE / sizeof(int)))
+
+// in-order walk of the implicit tree, handing out sorted keys as we go
+static size_t fill(eytzinger_t *tree, const int *sorted, size_t next, size_t node) {
+  if (node <= tree->count) {
+    next = fill(tree, sorted, next, 2 * node);
+    tree->keys[node] = sorted[next++];
+    next = fill(tree, sorted, next, 2 * node + 1);
+  }
+  return next;
+}
+
+void eytzinger_build(eytzinger_t *tree, const int *sorted, size_t count) {
+  tree->count = count;
+  // keys[0] is unused, so the root starts a line and so does each group
+  // of KEYS_PER_LINE descendants
+  size_t bytes = (count + 1) * sizeof(int);
+  bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  if ((tree->keys = aligned_alloc(CACHE_LINE_SIZE, bytes)) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  fill(tree, sorted, 0, 1);
+}
+
+int eytzinger_contains(const eytzinger_t *tree, int key) {
+  const int *keys = tree->keys;
+  size_t i = 1;
+  while (i <= tree->count) {
+    __builtin_prefetch(keys + KEYS_PER_LINE * i);
+    i = 2 * i + (keys[i] < key);
+  }
+  // undo the right turns taken after the last left turn, which lands on
+  // the smallest key not less than key, 0 if there isn't one
+  i >>= __builtin_ffsll(~i);
+  return i != 0 && keys[i] == key;
+}
+
+void eytzinger_destroy(eytzinger_t *tree) {
+  free(tree->keys);
+  tree->keys = NULL;
+  tree->count = 0;
+}
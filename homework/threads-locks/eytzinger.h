@@ -0,0 +1,21 @@
+#ifndef EYTZINGER_H_
+#define EYTZINGER_H_
+
+#include <stddef.h>
+
+// sorted keys laid out as a complete binary tree in breadth first order,
+// keys[1] is the root and the children of keys[i] are keys[2i] and
+// keys[2i + 1]. never changes once built, so any number of threads can
+// search it without locks
+typedef struct eytzinger_t {
+  int *keys;
+  size_t count;
+} eytzinger_t;
+
+// sorted is ascending, duplicates are fine
+void eytzinger_build(eytzinger_t *tree, const int *sorted, size_t count);
+// 1 if key is there, 0 otherwise
+int eytzinger_contains(const eytzinger_t *tree, int key);
+void eytzinger_destroy(eytzinger_t *tree);
+
+#endif
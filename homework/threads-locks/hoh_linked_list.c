@@ -5,113 +5,256 @@
   performance. When does a hand-over-hand list work better than a
   standard list as shown in the chapter?
   
-  gcc -o bin/hoh_linked_list hoh_linked_list.c timer.c
+  gcc -o bin/hoh_linked_list hoh_linked_list.c lock.c slab.c stripe.c timer.c
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include "lock.h"
+#include "slab.h"
+#include "stripe.h"
 #include "timer.h"
 
 typedef struct node_t {
   int key;
   struct node_t *next;
-  pthread_mutex_t lock;
 } node_t;
 
+// nodes come from slab when it is set, otherwise from malloc. a node's
+// lock is the stripe its address hashes to
 typedef struct list_t {
   node_t *head;
-  pthread_mutex_t lock;
+  lock_t lock;
+  slab_t *slab;
+  stripes_t stripes;
 } list_t;
 
+// a list with a lock in every node, what the stripes replaced. kept as
+// the baseline for the stripe counts
+typedef struct locked_node_t {
+  int key;
+  struct locked_node_t *next;
+  lock_t lock;
+} locked_node_t;
+
+typedef struct locked_list_t {
+  locked_node_t *head;
+  lock_t lock;
+} locked_list_t;
+
 #define NODE_COUNT 1000
+// from the sweep in main. from 4 stripes up the count makes no
+// difference, a lookup takes about twice as long as with a lock per node
+// either way. 64 is well inside that, 4KB of locks where a lock per node
+// takes 48KB
+#define LIST_STRIPES 64
 
-void list_init(list_t *list) {
+void list_init(list_t *list, slab_t *slab, int stripes) {
   list->head = NULL;
-  pthread_mutex_init(&list->lock, NULL);
+  list->slab = slab;
+  lock_init(&list->lock, lock_default_kind());
+  stripes_init(&list->stripes, stripes, lock_default_kind());
 }
 
-void *mutex_lock(pthread_mutex_t *lock, void *(*cb)(pthread_mutex_t *), pthread_mutex_t *args) {
-  if ((pthread_mutex_lock(lock)) != 0) {
-    fprintf(stderr, "Error locking mutex.\n");
-    if (cb) {
-      printf("CB!\n");
-      cb(args);
-    } else {
-      exit(EXIT_FAILURE);
-    }
+static node_t *create_node(list_t *list, int key) {
+  node_t *node = NULL;
+  if (list->slab) {
+    node = slab_alloc(list->slab);
+  } else if ((node = malloc(sizeof(node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
   }
-  return NULL;
+  node->key = key;
+  return node;
 }
 
-void *mutex_unlock(pthread_mutex_t *lock) {
-  if ((pthread_mutex_unlock(lock)) != 0) {
-    fprintf(stderr, "Error unlocking mutex.\n");
-    exit(EXIT_FAILURE);
+int prepend_node(list_t *list, int key) {
+  node_t *node = create_node(list, key);
+  lock_t *node_lock = stripe_lock(&list->stripes, node);
+  lock_acquire(&list->lock);
+  lock_acquire(node_lock);
+  node->next = list->head;
+  list->head = node;
+  lock_release(node_lock);
+  lock_release(&list->lock);
+  return 0;
+}
+
+// same result as prepending keys[0] to keys[n - 1] one at a time, but
+// the chain is built privately and spliced in with one lock acquisition
+int prepend_batch(list_t *list, const int *keys, int n) {
+  if (n <= 0) {
+    return 0;
+  }
+  node_t *last = create_node(list, keys[0]);
+  node_t *first = last;
+  for (int i = 1; i < n; i++) {
+    node_t *node = create_node(list, keys[i]);
+    node->next = first;
+    first = node;
   }
-  return NULL;
+  lock_acquire(&list->lock);
+  last->next = list->head;
+  list->head = first;
+  lock_release(&list->lock);
+  return 0;
 }
 
-int prepend_node(list_t *list, int key) {
-  node_t *node = NULL;
-  if ((node = malloc(sizeof(node_t))) == NULL) {
+// the list lock is only held until we have the head, after that each
+// node's stripe is taken before the previous one is released. starts
+// over from the head when stripe_couple gives up
+int hoh_lookup_node(list_t *list, int key) {
+  for (;;) {
+    lock_acquire(&list->lock);
+    node_t *curr = list->head;
+    if (curr == NULL) {
+      lock_release(&list->lock);
+      return -1;
+    }
+    lock_t *held = stripe_lock(&list->stripes, curr);
+    lock_acquire(held);
+    lock_release(&list->lock);
+    while (curr->key != key) {
+      node_t *next = curr->next;
+      if (next == NULL) {
+        lock_release(held);
+        return -1;
+      }
+      if ((held = stripe_couple(&list->stripes, held, next)) == NULL) {
+        break;
+      }
+      curr = next;
+    }
+    if (held != NULL) {
+      lock_release(held);
+      return 0;
+    }
+  }
+}
+
+void locked_list_init(locked_list_t *list) {
+  list->head = NULL;
+  lock_init(&list->lock, lock_default_kind());
+}
+
+int locked_prepend_node(locked_list_t *list, int key) {
+  locked_node_t *node = NULL;
+  if ((node = malloc(sizeof(locked_node_t))) == NULL) {
     fprintf(stderr, "Error allocating memory.\n");
     exit(EXIT_FAILURE);
   }
   node->key = key;
-  pthread_mutex_init(&node->lock, NULL);
-  mutex_lock(&list->lock, NULL, NULL);
-  mutex_lock(&node->lock, NULL, NULL);
+  lock_init(&node->lock, lock_default_kind());
+  lock_acquire(&list->lock);
   node->next = list->head;
   list->head = node;
-  mutex_unlock(&node->lock);
-  mutex_unlock(&list->lock);
+  lock_release(&list->lock);
   return 0;
 }
 
-int hoh_lookup_node(list_t *list, int key) {
+// hoh_lookup_node with a lock per node, which never has to start over
+int locked_hoh_lookup_node(locked_list_t *list, int key) {
   int rv = -1;
-  node_t *curr = list->head;
-  mutex_lock(&list->lock, NULL, NULL); 
+  lock_acquire(&list->lock);
+  locked_node_t *curr = list->head;
+  if (curr) {
+    lock_acquire(&curr->lock);
+  }
+  lock_release(&list->lock);
   while (curr) {
     if (curr->key == key) {
       rv = 0;
-      mutex_unlock(&curr->lock);
+      lock_release(&curr->lock);
       break;
     }
-    if (curr->next) {
-      mutex_lock(&curr->next->lock, mutex_unlock, &list->lock);
+    locked_node_t *next = curr->next;
+    if (next) {
+      lock_acquire(&next->lock);
     }
-    mutex_unlock(&curr->lock);
-    curr = curr->next;
+    lock_release(&curr->lock);
+    curr = next;
   }
-  mutex_unlock(&list->lock);
   return rv;
 }
 
 int main(void) {
-  list_t list;
-  list_init(&list);
-  
+  static slab_t slab;
+  slab_init(&slab, sizeof(node_t));
+
+  fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+
   timespec_t t1, t2;
 
   uint64_t seed_times[100] = { 0 };
   uint64_t search_times[100] = { 0 };
 
+  static int keys[NODE_COUNT];
+  for (int key = 0; key < NODE_COUNT; key++) {
+    keys[key] = key;
+  }
+
+  // the same run with nodes from malloc and then from the slab
+  for (int use_slab = 0; use_slab < 2; use_slab++) {
+    list_t list;
+    list_init(&list, use_slab ? &slab : NULL, LIST_STRIPES);
+
+    for (int i = 0; i < 100; i++) {
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+        for (int key = 0; key < NODE_COUNT; key++) {
+          prepend_node(&list, key);
+        }
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+      seed_times[i] = elapsed_nsecs(&t1, &t2);
+
+      // keys are prepended in order, so the 0 just added is the last of
+      // this round's nodes and finding it walks all NODE_COUNT of them
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+      hoh_lookup_node(&list, 0);
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+      search_times[i] = elapsed_nsecs(&t1, &t2);
+    }
+
+    fprintf(stdout, "Time to seed linked list (%s): %lluns\n", use_slab ? "slab" : "malloc", average_cost(seed_times, 100));
+    fprintf(stdout, "Time to find last node (%s): %lluns\n", use_slab ? "slab" : "malloc", average_cost(search_times, 100));
+  }
+
+  list_t list;
+  list_init(&list, NULL, LIST_STRIPES);
   for (int i = 0; i < 100; i++) {
     clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-      for (int key = 0; key < NODE_COUNT; key++) {
-        prepend_node(&list, key);
-      }
+    prepend_batch(&list, keys, NODE_COUNT);
     clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
     seed_times[i] = elapsed_nsecs(&t1, &t2);
+  }
 
+  fprintf(stdout, "Time to seed linked list (malloc, one batch): %lluns\n", average_cost(seed_times, 100));
+
+  // the same list with a lock per node, then with more and more stripes
+  locked_list_t locked_list;
+  locked_list_init(&locked_list);
+  for (int key = 0; key < NODE_COUNT; key++) {
+    locked_prepend_node(&locked_list, key);
+  }
+  for (int i = 0; i < 100; i++) {
     clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-    hoh_lookup_node(&list, NODE_COUNT - 1);
+    locked_hoh_lookup_node(&locked_list, 0);
     clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
     search_times[i] = elapsed_nsecs(&t1, &t2);
   }
-
-  fprintf(stdout, "Time to seed linked list: %lluns\n", average_cost(seed_times, 100));
-  fprintf(stdout, "Time to find last node: %lluns\n", average_cost(search_times, 100));
+  fprintf(stdout, "Time to find last node (lock per node, %zu bytes): %lluns\n",
+    NODE_COUNT * sizeof(lock_t), average_cost(search_times, 100));
+  for (int stripes = 1; stripes <= 4096; stripes *= 4) {
+    list_t striped;
+    list_init(&striped, NULL, stripes);
+    prepend_batch(&striped, keys, NODE_COUNT);
+    for (int i = 0; i < 100; i++) {
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+      hoh_lookup_node(&striped, 0);
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+      search_times[i] = elapsed_nsecs(&t1, &t2);
+    }
+    fprintf(stdout, "Time to find last node (%d stripes, %zu bytes): %lluns\n",
+      stripes, stripes_memory(&striped.stripes), average_cost(search_times, 100));
+  }
 }
@@ -0,0 +1,109 @@
+/*
+  Lazy synchronization list [HHL+05]. Lookups take no locks at all.
+  Insert and delete find their window without locks, lock only the
+  predecessor and current node, then check that neither has been deleted
+  and that they are still adjacent before changing anything.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "lazy_list.h"
+
+static lazy_node_t *create_node(lazy_list_t *list, int key, lazy_node_t *next) {
+  lazy_node_t *node = NULL;
+  if ((node = malloc(sizeof(lazy_node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  node->key = key;
+  atomic_init(&node->marked, 0);
+  atomic_init(&node->next, next);
+  lock_init(&node->lock, list->kind);
+  return node;
+}
+
+void lazy_list_init(lazy_list_t *list, lock_kind_t kind) {
+  list->kind = kind;
+  lazy_node_t *tail = create_node(list, INT_MAX, NULL);
+  list->head = create_node(list, INT_MIN, tail);
+}
+
+// pred is the last node with a key < key and curr the node after it
+static void find_window(lazy_list_t *list, int key, lazy_node_t **pred, lazy_node_t **curr) {
+  lazy_node_t *p = list->head;
+  lazy_node_t *c = atomic_load_explicit(&p->next, memory_order_acquire);
+  while (c->key < key) {
+    p = c;
+    c = atomic_load_explicit(&c->next, memory_order_acquire);
+  }
+  *pred = p;
+  *curr = c;
+}
+
+static int validate(lazy_node_t *pred, lazy_node_t *curr) {
+  return !atomic_load_explicit(&pred->marked, memory_order_relaxed) &&
+    !atomic_load_explicit(&curr->marked, memory_order_relaxed) &&
+    atomic_load_explicit(&pred->next, memory_order_relaxed) == curr;
+}
+
+// 0 if inserted, -1 if the key was already there
+int lazy_insert_node(lazy_list_t *list, int key) {
+  for (;;) {
+    lazy_node_t *pred, *curr;
+    find_window(list, key, &pred, &curr);
+    lock_acquire(&pred->lock);
+    lock_acquire(&curr->lock);
+    if (!validate(pred, curr)) {
+      lock_release(&curr->lock);
+      lock_release(&pred->lock);
+      continue;
+    }
+    int rv = -1;
+    if (curr->key != key) {
+      lazy_node_t *node = create_node(list, key, curr);
+      atomic_store_explicit(&pred->next, node, memory_order_release);
+      rv = 0;
+    }
+    lock_release(&curr->lock);
+    lock_release(&pred->lock);
+    return rv;
+  }
+}
+
+// 0 if deleted, -1 if the key wasn't there. the node is not freed since
+// lookups may still be reading it
+int lazy_delete_node(lazy_list_t *list, int key) {
+  for (;;) {
+    lazy_node_t *pred, *curr;
+    find_window(list, key, &pred, &curr);
+    lock_acquire(&pred->lock);
+    lock_acquire(&curr->lock);
+    if (!validate(pred, curr)) {
+      lock_release(&curr->lock);
+      lock_release(&pred->lock);
+      continue;
+    }
+    int rv = -1;
+    if (curr->key == key) {
+      atomic_store_explicit(&curr->marked, 1, memory_order_release);
+      atomic_store_explicit(&pred->next, atomic_load_explicit(&curr->next, memory_order_relaxed), memory_order_release);
+      rv = 0;
+    }
+    lock_release(&curr->lock);
+    lock_release(&pred->lock);
+    return rv;
+  }
+}
+
+// 0 if found, -1 if not. wait-free, one pass and no locks
+int lazy_lookup_node(lazy_list_t *list, int key) {
+  lazy_node_t *curr = list->head;
+  while (curr->key < key) {
+    curr = atomic_load_explicit(&curr->next, memory_order_acquire);
+  }
+  if (curr->key != key || atomic_load_explicit(&curr->marked, memory_order_acquire)) {
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef LAZY_LIST_H_
+#define LAZY_LIST_H_
+
+#include <stdatomic.h>
+#include "lock.h"
+
+// marked is set, under the node's lock, before the node is unlinked so a
+// lookup that is already standing on it knows it has gone
+typedef struct lazy_node_t {
+  int key;
+  atomic_int marked;
+  _Atomic(struct lazy_node_t *) next;
+  lock_t lock;
+} lazy_node_t;
+
+// sorted by key between a head and tail sentinel, no duplicates. keys must
+// be greater than INT_MIN and less than INT_MAX
+typedef struct lazy_list_t {
+  lazy_node_t *head;
+  lock_kind_t kind;
+} lazy_list_t;
+
+void lazy_list_init(lazy_list_t *list, lock_kind_t kind);
+int lazy_insert_node(lazy_list_t *list, int key);
+int lazy_delete_node(lazy_list_t *list, int key);
+int lazy_lookup_node(lazy_list_t *list, int key);
+
+#endif
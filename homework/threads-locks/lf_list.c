@@ -0,0 +1,117 @@
+/*
+  Lock-free sorted linked list after Harris [Har01], using Michael's
+  variant of the search that unlinks marked nodes as it goes. A delete
+  first marks the node's next pointer so nothing can be inserted after
+  it, then tries to swing its predecessor past it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lf_list.h"
+
+#define MARK ((uintptr_t) 1)
+
+static lf_node_t *node_ptr(uintptr_t link) {
+  return (lf_node_t *) (link & ~MARK);
+}
+
+static int is_marked(uintptr_t link) {
+  return (link & MARK) != 0;
+}
+
+void lf_list_init(lf_list_t *list) {
+  atomic_init(&list->head, 0);
+}
+
+// find the first node with a key >= key, and the link pointing at it.
+// marked nodes found on the way are unlinked, if that fails because the
+// predecessor changed under us start again from the head
+static lf_node_t *search(lf_list_t *list, int key, atomic_uintptr_t **prev_link) {
+retry:;
+  atomic_uintptr_t *prev = &list->head;
+  uintptr_t curr = atomic_load_explicit(prev, memory_order_acquire);
+  for (;;) {
+    lf_node_t *node = node_ptr(curr);
+    if (node == NULL) {
+      break;
+    }
+    uintptr_t next = atomic_load_explicit(&node->next, memory_order_acquire);
+    if (is_marked(next)) {
+      uintptr_t expected = curr;
+      if (!atomic_compare_exchange_strong_explicit(prev, &expected, next & ~MARK,
+            memory_order_acq_rel, memory_order_acquire)) {
+        goto retry;
+      }
+      curr = next & ~MARK;
+      continue;
+    }
+    if (node->key >= key) {
+      break;
+    }
+    prev = &node->next;
+    curr = next;
+  }
+  *prev_link = prev;
+  return node_ptr(curr);
+}
+
+// 0 if inserted, -1 if the key was already there
+int lf_insert_node(lf_list_t *list, int key) {
+  lf_node_t *node = NULL;
+  if ((node = malloc(sizeof(lf_node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  node->key = key;
+  for (;;) {
+    atomic_uintptr_t *prev = NULL;
+    lf_node_t *curr = search(list, key, &prev);
+    if (curr != NULL && curr->key == key) {
+      free(node);
+      return -1;
+    }
+    atomic_store_explicit(&node->next, (uintptr_t) curr, memory_order_relaxed);
+    uintptr_t expected = (uintptr_t) curr;
+    if (atomic_compare_exchange_strong_explicit(prev, &expected, (uintptr_t) node,
+          memory_order_release, memory_order_relaxed)) {
+      return 0;
+    }
+  }
+}
+
+// 0 if deleted, -1 if the key wasn't there
+int lf_delete_node(lf_list_t *list, int key) {
+  for (;;) {
+    atomic_uintptr_t *prev = NULL;
+    lf_node_t *curr = search(list, key, &prev);
+    if (curr == NULL || curr->key != key) {
+      return -1;
+    }
+    uintptr_t next = atomic_load_explicit(&curr->next, memory_order_acquire);
+    if (is_marked(next)) {
+      continue;
+    }
+    // marking is the delete, whoever marks it first owns it
+    if (!atomic_compare_exchange_strong_explicit(&curr->next, &next, next | MARK,
+          memory_order_acq_rel, memory_order_relaxed)) {
+      continue;
+    }
+    // unlink now if we can, otherwise the next search past it will
+    uintptr_t expected = (uintptr_t) curr;
+    atomic_compare_exchange_strong_explicit(prev, &expected, next,
+      memory_order_acq_rel, memory_order_relaxed);
+    return 0;
+  }
+}
+
+// 0 if found, -1 if not. only reads, never helps unlink or retries
+int lf_lookup_node(lf_list_t *list, int key) {
+  lf_node_t *curr = node_ptr(atomic_load_explicit(&list->head, memory_order_acquire));
+  while (curr != NULL && curr->key < key) {
+    curr = node_ptr(atomic_load_explicit(&curr->next, memory_order_acquire));
+  }
+  if (curr == NULL || curr->key != key) {
+    return -1;
+  }
+  return is_marked(atomic_load_explicit(&curr->next, memory_order_acquire)) ? -1 : 0;
+}
@@ -0,0 +1,24 @@
+#ifndef LF_LIST_H_
+#define LF_LIST_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// the low bit of next marks the node as deleted, nodes are never freed
+// once published since a lookup may still be standing on them
+typedef struct lf_node_t {
+  int key;
+  atomic_uintptr_t next;
+} lf_node_t;
+
+// sorted by key, no duplicates
+typedef struct lf_list_t {
+  atomic_uintptr_t head;
+} lf_list_t;
+
+void lf_list_init(lf_list_t *list);
+int lf_insert_node(lf_list_t *list, int key);
+int lf_delete_node(lf_list_t *list, int key);
+int lf_lookup_node(lf_list_t *list, int key);
+
+#endif
@@ -5,12 +5,14 @@
   performance. When does a hand-over-hand list work better than a
   standard list as shown in the chapter?
 
-  gcc -o bin/linked_list linked_list.c timer.c
+  gcc -o bin/linked_list linked_list.c lock.c slab.c timer.c
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include "lock.h"
+#include "slab.h"
 #include "timer.h"
 
 typedef struct node_t {
@@ -18,36 +20,66 @@ typedef struct node_t {
   struct node_t *next;
 } node_t;
 
+// nodes come from slab when it is set, otherwise from malloc
 typedef struct list_t {
   node_t *head;
-  pthread_mutex_t lock;
+  lock_t lock;
+  slab_t *slab;
 } list_t;
 
 #define NODE_COUNT 100
 
-void list_init(list_t *list) {
+void list_init(list_t *list, slab_t *slab) {
   list->head = NULL;
-  pthread_mutex_init(&list->lock, NULL);
+  list->slab = slab;
+  lock_init(&list->lock, lock_default_kind());
 }
 
-int prepend_node(list_t *list, int key) {
+static node_t *create_node(list_t *list, int key) {
   node_t *node = NULL;
-  if ((node = malloc(sizeof(node_t))) == NULL) {
+  if (list->slab) {
+    node = slab_alloc(list->slab);
+  } else if ((node = malloc(sizeof(node_t))) == NULL) {
     fprintf(stderr, "Error allocating memory.\n");
     exit(EXIT_FAILURE);
   }
   node->key = key;
-  pthread_mutex_lock(&list->lock);
+  return node;
+}
+
+int prepend_node(list_t *list, int key) {
+  node_t *node = create_node(list, key);
+  lock_acquire(&list->lock);
   node->next = list->head;
   list->head = node;
-  pthread_mutex_unlock(&list->lock);
+  lock_release(&list->lock);
+  return 0;
+}
+
+// same result as prepending keys[0] to keys[n - 1] one at a time, but
+// the chain is built privately and spliced in with one lock acquisition
+int prepend_batch(list_t *list, const int *keys, int n) {
+  if (n <= 0) {
+    return 0;
+  }
+  node_t *last = create_node(list, keys[0]);
+  node_t *first = last;
+  for (int i = 1; i < n; i++) {
+    node_t *node = create_node(list, keys[i]);
+    node->next = first;
+    first = node;
+  }
+  lock_acquire(&list->lock);
+  last->next = list->head;
+  list->head = first;
+  lock_release(&list->lock);
   return 0;
 }
 
 int lookup_node(list_t *list, int key) {
   int rv = -1;
+  lock_acquire(&list->lock);
   node_t *curr = list->head;
-  pthread_mutex_lock(&list->lock);
   while (curr) {
     if (curr->key == key) {
       rv = 0;
@@ -55,33 +87,59 @@ int lookup_node(list_t *list, int key) {
     }
     curr = curr->next;
   }
-  pthread_mutex_unlock(&list->lock);
+  lock_release(&list->lock);
   return rv;
 }
 
 int main(void) {
-  list_t list;
-  list_init(&list);
+  static slab_t slab;
+  slab_init(&slab, sizeof(node_t));
+
+  fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
 
   timespec_t t1, t2;
 
   uint64_t seed_times[100] = { 0 };
   uint64_t search_times[100] = { 0 };
 
+  static int keys[NODE_COUNT];
+  for (int key = 0; key < NODE_COUNT; key++) {
+    keys[key] = key;
+  }
+
+  // the same run with nodes from malloc and then from the slab
+  for (int use_slab = 0; use_slab < 2; use_slab++) {
+    list_t list;
+    list_init(&list, use_slab ? &slab : NULL);
+
+    for (int i = 0; i < 100; i++) {
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+        for (int key = 0; key < NODE_COUNT; key++) {
+          prepend_node(&list, key);
+        }
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+      seed_times[i] = elapsed_nsecs(&t1, &t2);
+
+      // keys are prepended in order, so the 0 just added is the last of
+      // this round's nodes and finding it walks all NODE_COUNT of them
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+      lookup_node(&list, 0);
+      clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+      search_times[i] = elapsed_nsecs(&t1, &t2);
+    }
+
+    fprintf(stdout, "Time to seed linked list (%s): %lluns\n", use_slab ? "slab" : "malloc", average_cost(seed_times, 100));
+    fprintf(stdout, "Time to find last node (%s): %lluns\n", use_slab ? "slab" : "malloc", average_cost(search_times, 100));
+  }
+
+  list_t list;
+  list_init(&list, NULL);
   for (int i = 0; i < 100; i++) {
     clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-      for (int key = 0; key < NODE_COUNT; key++) {
-        prepend_node(&list, key);
-      }
+    prepend_batch(&list, keys, NODE_COUNT);
     clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
     seed_times[i] = elapsed_nsecs(&t1, &t2);
-
-    clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-    lookup_node(&list, NODE_COUNT - 1);
-    clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
-    search_times[i] = elapsed_nsecs(&t1, &t2);
   }
 
-  fprintf(stdout, "Time to seed linked list: %lluns\n", average_cost(seed_times, 100));
-  fprintf(stdout, "Time to find last node: %lluns\n", average_cost(search_times, 100));
+  fprintf(stdout, "Time to seed linked list (malloc, one batch): %lluns\n", average_cost(seed_times, 100));
 }
@@ -5,102 +5,310 @@
   performance. When does a hand-over-hand list work better than a
   standard list as shown in the chapter?
   
-  gcc -o bin/hoh_linked_list_threads hoh_linked_list_threads.c timer.c
+  gcc -o bin/linked_list_threads linked_list_threads.c lazy_list.c lf_list.c lock.c rcu.c slab.c stripe.c unrolled_list.c worker_pool.c timer.c
+
+  ./linked_list_threads                 find the last node from THREAD_COUNT threads
+  ./linked_list_threads oversubscribe   random lookups at 1x, 4x and 32x the cpu count
+  ./linked_list_threads mixed           mostly lookups with some inserts and deletes
+  ./linked_list_threads rcu             lookup scaling while a writer keeps prepending
+  ./linked_list_threads batch           prepend throughput as the batch size grows
+  ./linked_list_threads rwlock          reader-writer locks from 50% to 99% lookups
+  ./linked_list_threads stripes         hand-over-hand lookups as the stripe count grows
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include "lazy_list.h"
+#include "lf_list.h"
+#include "lock.h"
+#include "rcu.h"
+#include "slab.h"
+#include "stripe.h"
 #include "timer.h"
+#include "unrolled_list.h"
+#include "worker_pool.h"
 
 typedef struct node_t {
   int key;
   struct node_t *next;
-  pthread_mutex_t lock;
 } node_t;
 
+// nodes come from slab when it is set, otherwise from malloc. a node's
+// lock is the stripe its address hashes to
 typedef struct list_t {
   node_t *head;
-  pthread_mutex_t lock;
+  lock_t lock;
+  lock_kind_t kind;
+  slab_t *slab;
+  stripes_t stripes;
 } list_t;
 
+// a list with a lock in every node, what the stripes replaced. kept as
+// the baseline for the stripes benchmark
+typedef struct locked_node_t {
+  int key;
+  struct locked_node_t *next;
+  lock_t lock;
+} locked_node_t;
+
+typedef struct locked_list_t {
+  locked_node_t *head;
+  lock_t lock;
+} locked_list_t;
+
+// list_t with its lock replaced by a reader-writer lock
+typedef struct rw_list_t {
+  list_t list;
+  rwlock_t lock;
+} rw_list_t;
+
 typedef struct args_t {
   list_t *list;
+  lf_list_t *lf_list;
+  unrolled_list_t *unrolled_list;
   int iter;
   pthread_mutex_t iter_lock;
   uint64_t *search_times;
 } args_t;
 
+typedef struct lookup_args_t {
+  list_t *list;
+  locked_list_t *locked_list;
+  int (*lookup)(list_t *list, int key);
+  unsigned int seed;
+  int lookups;
+} lookup_args_t;
+
 #define NODE_COUNT 4000000
 #define THREAD_COUNT 64
+#define OVERSUBSCRIBE_NODE_COUNT 1000
+#define OVERSUBSCRIBE_LOOKUPS 100000 // shared between all the threads
+#define MIXED_KEY_RANGE 1024
+#define MIXED_OPS 200000 // shared between all the threads
+#define MIXED_READ_PERCENT 95 // the rest split evenly between insert and delete
+#define RWLOCK_THREAD_STEP 4 // 1, 4, 16 ... THREAD_COUNT threads
+#define RCU_NODE_COUNT 10000
+#define RCU_LOOKUPS 20000 // shared between all the readers
+#define BATCH_KEYS 262144 // shared between all the threads
+#define MAX_BATCH 1024
+#define LIST_STRIPES 64 // the stripes sweep is flat from 4 up, one per thread
+#define MAX_STRIPES 65536
+#define NSEC_IN_SEC 1000000000 // 1,000,000,000
+
+// one list strategy behind a common set interface for the mixed benchmark
+typedef struct set_ops_t {
+  const char *name;
+  int (*insert)(void *set, int key);
+  int (*delete)(void *set, int key);
+  int (*lookup)(void *set, int key);
+} set_ops_t;
+
+// one writer prepending new keys and deleting the oldest so the list stays
+// RCU_NODE_COUNT long, readers look up keys still in that window
+typedef struct writer_args_t {
+  list_t *list;
+  atomic_int next_key;
+  atomic_int stop;
+  int updates;
+} writer_args_t;
+
+typedef struct batch_args_t {
+  list_t *list;
+  int (*prepend)(list_t *list, const int *keys, int n);
+  int batch;
+  int first_key;
+  int count;
+} batch_args_t;
+
+typedef struct reader_args_t {
+  writer_args_t *writer;
+  int (*lookup)(list_t *list, int key);
+  unsigned int seed;
+  int lookups;
+} reader_args_t;
+
+typedef struct mixed_args_t {
+  const set_ops_t *ops;
+  void *set;
+  unsigned int seed;
+  int count;
+  int read_percent;
+} mixed_args_t;
 
-void list_init(list_t *list) {
+void list_init_striped(list_t *list, lock_kind_t kind, slab_t *slab, int stripes) {
   list->head = NULL;
-  pthread_mutex_init(&list->lock, NULL);
+  list->kind = kind;
+  list->slab = slab;
+  lock_init(&list->lock, kind);
+  stripes_init(&list->stripes, stripes, kind);
 }
 
-void *mutex_lock(pthread_mutex_t *lock, void *(*cb)(pthread_mutex_t *), pthread_mutex_t *args) {
-  if ((pthread_mutex_lock(lock)) != 0) {
-    fprintf(stderr, "Error locking mutex.\n");
-    if (cb) {
-      printf("CB!\n");
-      cb(args);
-    } else {
-      exit(EXIT_FAILURE);
-    }
-  }
-  return NULL;
+void list_init(list_t *list, lock_kind_t kind, slab_t *slab) {
+  list_init_striped(list, kind, slab, LIST_STRIPES);
 }
 
-void *mutex_unlock(pthread_mutex_t *lock) {
-  if ((pthread_mutex_unlock(lock)) != 0) {
-    fprintf(stderr, "Error unlocking mutex.\n");
+static node_t *create_node(list_t *list, int key) {
+  node_t *node = NULL;
+  if (list->slab) {
+    node = slab_alloc(list->slab);
+  } else if ((node = malloc(sizeof(node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
     exit(EXIT_FAILURE);
   }
-  return NULL;
+  node->key = key;
+  return node;
+}
+
+static void free_node(list_t *list, node_t *node) {
+  if (list->slab) {
+    slab_free(list->slab, node);
+  } else {
+    free(node);
+  }
 }
 
 int prepend_node(list_t *list, int key) {
-  node_t *node = NULL;
-  if ((node = malloc(sizeof(node_t))) == NULL) {
+  node_t *node = create_node(list, key);
+  lock_t *node_lock = stripe_lock(&list->stripes, node);
+  lock_acquire(&list->lock);
+  lock_acquire(node_lock);
+  node->next = list->head;
+  // release so an rcu reader that sees the node also sees its key and next
+  __atomic_store_n(&list->head, node, __ATOMIC_RELEASE);
+  lock_release(node_lock);
+  lock_release(&list->lock);
+  return 0;
+}
+
+static node_t *create_chain(list_t *list, const int *keys, int n, node_t **last) {
+  node_t *first = create_node(list, keys[0]);
+  *last = first;
+  for (int i = 1; i < n; i++) {
+    node_t *node = create_node(list, keys[i]);
+    node->next = first;
+    first = node;
+  }
+  return first;
+}
+
+// same result as prepending keys[0] to keys[n - 1] one at a time, but
+// the chain is built privately and spliced in with one lock acquisition
+int prepend_batch(list_t *list, const int *keys, int n) {
+  if (n <= 0) {
+    return 0;
+  }
+  node_t *last = NULL;
+  node_t *first = create_chain(list, keys, n, &last);
+  lock_acquire(&list->lock);
+  last->next = list->head;
+  __atomic_store_n(&list->head, first, __ATOMIC_RELEASE);
+  lock_release(&list->lock);
+  return 0;
+}
+
+// prepend_batch with one compare-and-swap of the head instead of the list
+// lock. only safe while every other writer is also a cas_prepend_batch,
+// and readers either do the same or use rcu_lookup_node
+int cas_prepend_batch(list_t *list, const int *keys, int n) {
+  if (n <= 0) {
+    return 0;
+  }
+  node_t *last = NULL;
+  node_t *first = create_chain(list, keys, n, &last);
+  node_t *head = __atomic_load_n(&list->head, __ATOMIC_RELAXED);
+  do {
+    last->next = head;
+  } while (!__atomic_compare_exchange_n(&list->head, &head, first, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  return 0;
+}
+
+// the list lock is only held until we have the head, after that each
+// node's stripe is taken before the previous one is released. starts
+// over from the head when stripe_couple gives up
+int hoh_lookup_node(list_t *list, int key) {
+  for (;;) {
+    lock_acquire(&list->lock);
+    node_t *curr = list->head;
+    if (curr == NULL) {
+      lock_release(&list->lock);
+      return -1;
+    }
+    lock_t *held = stripe_lock(&list->stripes, curr);
+    lock_acquire(held);
+    lock_release(&list->lock);
+    while (curr->key != key) {
+      node_t *next = curr->next;
+      if (next == NULL) {
+        lock_release(held);
+        return -1;
+      }
+      if ((held = stripe_couple(&list->stripes, held, next)) == NULL) {
+        break;
+      }
+      curr = next;
+    }
+    if (held != NULL) {
+      lock_release(held);
+      return 0;
+    }
+  }
+}
+
+void locked_list_init(locked_list_t *list, lock_kind_t kind) {
+  list->head = NULL;
+  lock_init(&list->lock, kind);
+}
+
+int locked_prepend_node(locked_list_t *list, int key) {
+  locked_node_t *node = NULL;
+  if ((node = malloc(sizeof(locked_node_t))) == NULL) {
     fprintf(stderr, "Error allocating memory.\n");
     exit(EXIT_FAILURE);
   }
   node->key = key;
-  pthread_mutex_init(&node->lock, NULL);
-  mutex_lock(&list->lock, NULL, NULL);
-  mutex_lock(&node->lock, NULL, NULL);
+  lock_init(&node->lock, list->lock.kind);
+  lock_acquire(&list->lock);
   node->next = list->head;
   list->head = node;
-  mutex_unlock(&node->lock);
-  mutex_unlock(&list->lock);
+  lock_release(&list->lock);
   return 0;
 }
 
-int hoh_lookup_node(list_t *list, int key) {
+// hoh_lookup_node with a lock per node. no two nodes share a lock, so
+// coupling can always wait and never starts over
+int locked_hoh_lookup_node(locked_list_t *list, int key) {
   int rv = -1;
-  node_t *curr = list->head;
-  mutex_lock(&list->lock, NULL, NULL); 
+  lock_acquire(&list->lock);
+  locked_node_t *curr = list->head;
+  if (curr) {
+    lock_acquire(&curr->lock);
+  }
+  lock_release(&list->lock);
   while (curr) {
     if (curr->key == key) {
       rv = 0;
-      mutex_unlock(&curr->lock);
+      lock_release(&curr->lock);
       break;
     }
-    if (curr->next) {
-      mutex_lock(&curr->next->lock, mutex_unlock, &list->lock);
+    locked_node_t *next = curr->next;
+    if (next) {
+      lock_acquire(&next->lock);
     }
-    mutex_unlock(&curr->lock);
-    curr = curr->next;
+    lock_release(&curr->lock);
+    curr = next;
   }
-  mutex_unlock(&list->lock);
   return rv;
 }
 
 int lookup_node(list_t *list, int key) {
   int rv = -1;
+  lock_acquire(&list->lock);
   node_t *curr = list->head;
-  pthread_mutex_lock(&list->lock);
   while (curr) {
     if (curr->key == key) {
       rv = 0;
@@ -108,17 +316,165 @@ int lookup_node(list_t *list, int key) {
     }
     curr = curr->next;
   }
-  pthread_mutex_unlock(&list->lock);
+  lock_release(&list->lock);
+  return rv;
+}
+
+// no locks at all, writers only ever publish fully built nodes and do not
+// free an unlinked one until every reader that might be on it has left
+int rcu_lookup_node(list_t *list, int key) {
+  int rv = -1;
+  rcu_read_lock();
+  node_t *curr = __atomic_load_n(&list->head, __ATOMIC_ACQUIRE);
+  while (curr) {
+    if (curr->key == key) {
+      rv = 0;
+      break;
+    }
+    curr = __atomic_load_n(&curr->next, __ATOMIC_ACQUIRE);
+  }
+  rcu_read_unlock();
   return rv;
 }
 
+// prepend the key unless it is already there, all under the list lock
+int insert_node(list_t *list, int key) {
+  node_t *node = create_node(list, key);
+  lock_acquire(&list->lock);
+  for (node_t *curr = list->head; curr; curr = curr->next) {
+    if (curr->key == key) {
+      lock_release(&list->lock);
+      free_node(list, node);
+      return -1;
+    }
+  }
+  node->next = list->head;
+  list->head = node;
+  lock_release(&list->lock);
+  return 0;
+}
+
+// unlink the key under the list lock. the node is not freed because a
+// hand-over-hand lookup may be holding it
+int delete_node(list_t *list, int key) {
+  int rv = -1;
+  lock_acquire(&list->lock);
+  node_t **prev = &list->head;
+  for (node_t *curr = list->head; curr; prev = &curr->next, curr = curr->next) {
+    if (curr->key == key) {
+      *prev = curr->next;
+      rv = 0;
+      break;
+    }
+  }
+  lock_release(&list->lock);
+  return rv;
+}
+
+// unlink under the list lock like delete_node, then wait out a grace
+// period and free the node. only safe when nothing uses hoh_lookup_node
+int rcu_delete_node(list_t *list, int key) {
+  node_t *node = NULL;
+  lock_acquire(&list->lock);
+  node_t **prev = &list->head;
+  for (node_t *curr = list->head; curr; prev = &curr->next, curr = curr->next) {
+    if (curr->key == key) {
+      __atomic_store_n(prev, curr->next, __ATOMIC_RELEASE);
+      node = curr;
+      break;
+    }
+  }
+  lock_release(&list->lock);
+  if (node == NULL) {
+    return -1;
+  }
+  rcu_synchronize();
+  free_node(list, node);
+  return 0;
+}
+
+void rw_list_init(rw_list_t *list, rwlock_kind_t kind) {
+  list_init(&list->list, lock_default_kind(), NULL);
+  rwlock_init(&list->lock, kind);
+}
+
+int rw_insert_node(rw_list_t *list, int key) {
+  node_t *node = create_node(&list->list, key);
+  rwlock_write_acquire(&list->lock);
+  for (node_t *curr = list->list.head; curr; curr = curr->next) {
+    if (curr->key == key) {
+      rwlock_write_release(&list->lock);
+      free_node(&list->list, node);
+      return -1;
+    }
+  }
+  node->next = list->list.head;
+  list->list.head = node;
+  rwlock_write_release(&list->lock);
+  return 0;
+}
+
+int rw_delete_node(rw_list_t *list, int key) {
+  int rv = -1;
+  rwlock_write_acquire(&list->lock);
+  node_t **prev = &list->list.head;
+  for (node_t *curr = list->list.head; curr; prev = &curr->next, curr = curr->next) {
+    if (curr->key == key) {
+      *prev = curr->next;
+      rv = 0;
+      break;
+    }
+  }
+  rwlock_write_release(&list->lock);
+  return rv;
+}
+
+int rw_lookup_node(rw_list_t *list, int key) {
+  int rv = -1;
+  rwlock_read_acquire(&list->lock);
+  for (node_t *curr = list->list.head; curr; curr = curr->next) {
+    if (curr->key == key) {
+      rv = 0;
+      break;
+    }
+  }
+  rwlock_read_release(&list->lock);
+  return rv;
+}
+
+static int single_lock_insert(void *set, int key) { return insert_node(set, key); }
+static int single_lock_delete(void *set, int key) { return delete_node(set, key); }
+static int single_lock_lookup(void *set, int key) { return lookup_node(set, key); }
+static int lazy_insert(void *set, int key) { return lazy_insert_node(set, key); }
+static int lazy_delete(void *set, int key) { return lazy_delete_node(set, key); }
+static int lazy_lookup(void *set, int key) { return lazy_lookup_node(set, key); }
+static int lock_free_insert(void *set, int key) { return lf_insert_node(set, key); }
+static int lock_free_delete(void *set, int key) { return lf_delete_node(set, key); }
+static int lock_free_lookup(void *set, int key) { return lf_lookup_node(set, key); }
+static int rwlock_insert(void *set, int key) { return rw_insert_node(set, key); }
+static int rwlock_delete(void *set, int key) { return rw_delete_node(set, key); }
+static int rwlock_lookup(void *set, int key) { return rw_lookup_node(set, key); }
+
+static const set_ops_t set_ops[] = {
+  { "single", single_lock_insert, single_lock_delete, single_lock_lookup },
+  { "lazy", lazy_insert, lazy_delete, lazy_lookup },
+  { "lockfree", lock_free_insert, lock_free_delete, lock_free_lookup },
+};
+
+static void record_search_time(args_t *a, timespec_t *t1, timespec_t *t2) {
+  pthread_mutex_lock(&a->iter_lock);
+  a->search_times[a->iter++] = elapsed_nsecs(t1, t2);
+  pthread_mutex_unlock(&a->iter_lock);
+}
+
+// keys 0..NODE_COUNT-1 are prepended in order, so 0 is the last node
 void *hoh_start_routine(void *args) {
   args_t *a = (args_t *) args;
   timespec_t t1, t2;
   clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-  hoh_lookup_node(a->list, NODE_COUNT - 1);
+  hoh_lookup_node(a->list, 0);
   clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
-  a->search_times[a->iter++] = elapsed_nsecs(&t1, &t2);
+  record_search_time(a, &t1, &t2);
   return NULL;
 }
 
@@ -126,17 +482,427 @@ void *single_lock_start_routine(void *args) {
   args_t *a = (args_t *) args;
   timespec_t t1, t2;
   clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
-  lookup_node(a->list, NODE_COUNT - 1);
+  lookup_node(a->list, 0);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  record_search_time(a, &t1, &t2);
+  return NULL;
+}
+
+void *rcu_start_routine(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  rcu_lookup_node(a->list, 0);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  record_search_time(a, &t1, &t2);
+  return NULL;
+}
+
+// keys are prepended in order here too, 0 is in the last node
+void *unrolled_hoh_start_routine(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  unrolled_hoh_lookup_node(a->unrolled_list, 0);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  record_search_time(a, &t1, &t2);
+  return NULL;
+}
+
+void *unrolled_start_routine(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  unrolled_lookup_node(a->unrolled_list, 0);
   clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
-  a->search_times[a->iter++] = elapsed_nsecs(&t1, &t2);
+  record_search_time(a, &t1, &t2);
   return NULL;
 }
 
-int main(void) {
+// the lock-free list is sorted, so its last node is NODE_COUNT - 1
+void *lock_free_start_routine(void *args) {
+  args_t *a = (args_t *) args;
+  timespec_t t1, t2;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  lf_lookup_node(a->lf_list, NODE_COUNT - 1);
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  record_search_time(a, &t1, &t2);
+  return NULL;
+}
+
+void *lookup_start_routine(void *args) {
+  lookup_args_t *a = (lookup_args_t *) args;
+  for (int i = 0; i < a->lookups; i++) {
+    a->lookup(a->list, rand_r(&a->seed) % OVERSUBSCRIBE_NODE_COUNT);
+  }
+  return NULL;
+}
+
+void *locked_lookup_start_routine(void *args) {
+  lookup_args_t *a = (lookup_args_t *) args;
+  for (int i = 0; i < a->lookups; i++) {
+    locked_hoh_lookup_node(a->locked_list, rand_r(&a->seed) % OVERSUBSCRIBE_NODE_COUNT);
+  }
+  return NULL;
+}
+
+// random lookups on a short list with 1x, 4x and 32x as many threads as
+// cpus, for a pure spinlock, pthread mutex and the futex lock
+static void run_oversubscribe_benchmark(void) {
+  static const lock_kind_t kinds[] = { LOCK_MUTEX, LOCK_TTAS, LOCK_FUTEX };
+  static const int factors[] = { 1, 4, 32 };
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  worker_pool_t pool;
+  pool_init(&pool, cpus * 32);
+  lookup_args_t *args = NULL;
+  if ((args = malloc(cpus * 32 * sizeof(lookup_args_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int k = 0; k < (int) (sizeof(kinds) / sizeof(kinds[0])); k++) {
+    list_t list;
+    list_init(&list, kinds[k], NULL);
+    for (int i = 0; i < OVERSUBSCRIBE_NODE_COUNT; i++) {
+      prepend_node(&list, i);
+    }
+    for (int f = 0; f < (int) (sizeof(factors) / sizeof(factors[0])); f++) {
+      int threads = cpus * factors[f];
+      for (int hoh = 0; hoh < 2; hoh++) {
+        for (int i = 0; i < threads; i++) {
+          args[i].list = &list;
+          args[i].lookup = hoh ? hoh_lookup_node : lookup_node;
+          args[i].seed = i;
+          args[i].lookups = OVERSUBSCRIBE_LOOKUPS / threads;
+        }
+        uint64_t elapsed = pool_run(&pool, threads, lookup_start_routine, args, sizeof(lookup_args_t));
+        double lookups_per_sec = (double) (OVERSUBSCRIBE_LOOKUPS / threads) * threads * NSEC_IN_SEC / elapsed;
+        fprintf(stdout, "%-6s %-6s %2dx threads: %4d lookups/sec: %.0f\n",
+          lock_kind_name(kinds[k]), hoh ? "hoh" : "single", factors[f], threads, lookups_per_sec);
+      }
+    }
+  }
+
+  free(args);
+  pool_destroy(&pool);
+}
+
+// hand-over-hand lookups on a short list from THREAD_COUNT threads, with
+// a lock per node and then 1 to MAX_STRIPES stripes. fewer stripes save
+// memory, but threads on different nodes start to wait for each other
+static void run_stripes_benchmark(void) {
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+  static lookup_args_t args[THREAD_COUNT];
+
+  locked_list_t locked_list;
+  locked_list_init(&locked_list, lock_default_kind());
+  for (int i = 0; i < OVERSUBSCRIBE_NODE_COUNT; i++) {
+    locked_prepend_node(&locked_list, i);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    args[i].locked_list = &locked_list;
+    args[i].seed = i;
+    args[i].lookups = OVERSUBSCRIBE_LOOKUPS / THREAD_COUNT;
+  }
+  uint64_t elapsed = pool_run(&pool, THREAD_COUNT, locked_lookup_start_routine, args, sizeof(lookup_args_t));
+  double lookups_per_sec = (double) (OVERSUBSCRIBE_LOOKUPS / THREAD_COUNT) * THREAD_COUNT * NSEC_IN_SEC / elapsed;
+  fprintf(stdout, "per node     lock memory: %8zu bytes lookups/sec: %.0f\n",
+    OVERSUBSCRIBE_NODE_COUNT * sizeof(lock_t), lookups_per_sec);
+
+  for (int stripes = 1; stripes <= MAX_STRIPES; stripes *= 4) {
+    list_t list;
+    list_init_striped(&list, lock_default_kind(), NULL, stripes);
+    for (int i = 0; i < OVERSUBSCRIBE_NODE_COUNT; i++) {
+      prepend_node(&list, i);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+      args[i].list = &list;
+      args[i].lookup = hoh_lookup_node;
+      args[i].seed = i;
+      args[i].lookups = OVERSUBSCRIBE_LOOKUPS / THREAD_COUNT;
+    }
+    elapsed = pool_run(&pool, THREAD_COUNT, lookup_start_routine, args, sizeof(lookup_args_t));
+    lookups_per_sec = (double) (OVERSUBSCRIBE_LOOKUPS / THREAD_COUNT) * THREAD_COUNT * NSEC_IN_SEC / elapsed;
+    fprintf(stdout, "stripes: %5d lock memory: %8zu bytes lookups/sec: %.0f\n",
+      stripes, stripes_memory(&list.stripes), lookups_per_sec);
+  }
+
+  pool_destroy(&pool);
+}
+
+void *writer_start_routine(void *args) {
+  writer_args_t *a = (writer_args_t *) args;
+  while (!atomic_load_explicit(&a->stop, memory_order_relaxed)) {
+    int key = atomic_load_explicit(&a->next_key, memory_order_relaxed);
+    prepend_node(a->list, key);
+    atomic_store_explicit(&a->next_key, key + 1, memory_order_relaxed);
+    rcu_delete_node(a->list, key - RCU_NODE_COUNT);
+    a->updates++;
+  }
+  return NULL;
+}
+
+void *reader_start_routine(void *args) {
+  reader_args_t *a = (reader_args_t *) args;
+  for (int i = 0; i < a->lookups; i++) {
+    int newest = atomic_load_explicit(&a->writer->next_key, memory_order_relaxed) - 1;
+    a->lookup(a->writer->list, newest - rand_r(&a->seed) % RCU_NODE_COUNT);
+  }
+  return NULL;
+}
+
+// readers from 1 to THREAD_COUNT against a list one writer never stops
+// changing, with the readers taking the list lock or using rcu
+static void run_rcu_benchmark(void) {
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+  static reader_args_t args[THREAD_COUNT];
+
+  for (int rcu = 0; rcu < 2; rcu++) {
+    for (int threads = 1; threads <= THREAD_COUNT; threads *= 2) {
+      list_t list;
+      list_init(&list, lock_default_kind(), NULL);
+      for (int key = 0; key < RCU_NODE_COUNT; key++) {
+        prepend_node(&list, key);
+      }
+      writer_args_t writer = { 0 };
+      writer.list = &list;
+      atomic_init(&writer.next_key, RCU_NODE_COUNT);
+      atomic_init(&writer.stop, 0);
+
+      for (int i = 0; i < threads; i++) {
+        args[i].writer = &writer;
+        args[i].lookup = rcu ? rcu_lookup_node : lookup_node;
+        args[i].seed = i;
+        args[i].lookups = RCU_LOOKUPS / threads;
+      }
+      pthread_t writer_thread;
+      pthread_create(&writer_thread, NULL, writer_start_routine, &writer);
+      uint64_t elapsed = pool_run(&pool, threads, reader_start_routine, args, sizeof(reader_args_t));
+      atomic_store(&writer.stop, 1);
+      pthread_join(writer_thread, NULL);
+
+      double lookups_per_sec = (double) (RCU_LOOKUPS / threads) * threads * NSEC_IN_SEC / elapsed;
+      double updates_per_sec = (double) writer.updates * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-6s readers: %3d lookups/sec: %.0f writer updates/sec: %.0f\n",
+        rcu ? "rcu" : "single", threads, lookups_per_sec, updates_per_sec);
+    }
+  }
+
+  pool_destroy(&pool);
+}
+
+void *batch_start_routine(void *args) {
+  batch_args_t *a = (batch_args_t *) args;
+  int keys[MAX_BATCH];
+  for (int done = 0; done < a->count; done += a->batch) {
+    int n = a->count - done < a->batch ? a->count - done : a->batch;
+    for (int i = 0; i < n; i++) {
+      keys[i] = a->first_key + done + i;
+    }
+    a->prepend(a->list, keys, n);
+  }
+  return NULL;
+}
+
+// THREAD_COUNT threads prepending BATCH_KEYS keys between them into one
+// list, batch keys at a time, under the list lock and with a single cas
+static void run_batch_benchmark(void) {
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+  static batch_args_t args[THREAD_COUNT];
+  static slab_t slab;
+
+  for (int cas = 0; cas < 2; cas++) {
+    for (int batch = 1; batch <= MAX_BATCH; batch *= 4) {
+      // every node goes back in one go when the slab is destroyed
+      slab_init(&slab, sizeof(node_t));
+      list_t list;
+      list_init(&list, lock_default_kind(), &slab);
+      for (int i = 0; i < THREAD_COUNT; i++) {
+        args[i].list = &list;
+        args[i].prepend = cas ? cas_prepend_batch : prepend_batch;
+        args[i].batch = batch;
+        args[i].first_key = i * (BATCH_KEYS / THREAD_COUNT);
+        args[i].count = BATCH_KEYS / THREAD_COUNT;
+      }
+      uint64_t elapsed = pool_run(&pool, THREAD_COUNT, batch_start_routine, args, sizeof(batch_args_t));
+
+      int expected = (BATCH_KEYS / THREAD_COUNT) * THREAD_COUNT;
+      int count = 0;
+      for (node_t *curr = list.head; curr; curr = curr->next) {
+        count++;
+      }
+      if (count != expected) {
+        fprintf(stderr, "Error list has %d nodes, expected %d\n", count, expected);
+        exit(EXIT_FAILURE);
+      }
+      double keys_per_sec = (double) expected * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-4s batch: %4d keys/sec: %.0f\n", cas ? "cas" : "lock", batch, keys_per_sec);
+      slab_destroy(&slab);
+    }
+  }
+
+  pool_destroy(&pool);
+}
+
+void *mixed_start_routine(void *args) {
+  mixed_args_t *a = (mixed_args_t *) args;
+  for (int i = 0; i < a->count; i++) {
+    int key = rand_r(&a->seed) % MIXED_KEY_RANGE;
+    int op = rand_r(&a->seed) % 100;
+    // insert or delete gets a draw of its own, splitting the write range
+    // by parity is uneven when it is odd and the set drifts
+    if (op < a->read_percent) {
+      a->ops->lookup(a->set, key);
+    } else if (rand_r(&a->seed) % 2 == 0) {
+      a->ops->insert(a->set, key);
+    } else {
+      a->ops->delete(a->set, key);
+    }
+  }
+  return NULL;
+}
+
+// MIXED_READ_PERCENT lookups on a set half full of MIXED_KEY_RANGE keys,
+// for each list strategy from 1 to THREAD_COUNT threads
+static void run_mixed_benchmark(void) {
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+  static mixed_args_t args[THREAD_COUNT];
+
+  for (int s = 0; s < (int) (sizeof(set_ops) / sizeof(set_ops[0])); s++) {
+    for (int threads = 1; threads <= THREAD_COUNT; threads *= 2) {
+      list_t list;
+      lazy_list_t lazy;
+      lf_list_t lf;
+      void *sets[] = { &list, &lazy, &lf };
+      list_init(&list, lock_default_kind(), NULL);
+      lazy_list_init(&lazy, lock_default_kind());
+      lf_list_init(&lf);
+      for (int key = 0; key < MIXED_KEY_RANGE; key += 2) {
+        set_ops[s].insert(sets[s], key);
+      }
+
+      for (int i = 0; i < threads; i++) {
+        args[i].ops = &set_ops[s];
+        args[i].set = sets[s];
+        args[i].seed = i;
+        args[i].count = MIXED_OPS / threads;
+        args[i].read_percent = MIXED_READ_PERCENT;
+      }
+      uint64_t elapsed = pool_run(&pool, threads, mixed_start_routine, args, sizeof(mixed_args_t));
+      double ops_per_sec = (double) (MIXED_OPS / threads) * threads * NSEC_IN_SEC / elapsed;
+      fprintf(stdout, "%-8s threads: %3d ops/sec: %.0f\n", set_ops[s].name, threads, ops_per_sec);
+    }
+  }
+
+  pool_destroy(&pool);
+}
+
+static int list_size(list_t *list) {
+  int size = 0;
+  for (node_t *curr = list->head; curr; curr = curr->next) {
+    size++;
+  }
+  return size;
+}
+
+// the mixed workload on list_t from 50% to 99% lookups, with the plain
+// list lock and then each kind of reader-writer lock. the size the list
+// ends at is printed, inserts and deletes balance so it should stay near
+// the MIXED_KEY_RANGE / 2 it starts at
+static void run_rwlock_benchmark(void) {
+  static const int read_percents[] = { 50, 75, 90, 95, 99 };
+  static const set_ops_t rwlock_ops = { "rwlock", rwlock_insert, rwlock_delete, rwlock_lookup };
+  worker_pool_t pool;
+  pool_init(&pool, THREAD_COUNT);
+  static mixed_args_t args[THREAD_COUNT];
+
+  for (int r = 0; r < (int) (sizeof(read_percents) / sizeof(read_percents[0])); r++) {
+    // -1 is the list's own lock
+    for (int kind = -1; kind < RWLOCK_KINDS; kind++) {
+      for (int threads = 1; threads <= THREAD_COUNT; threads *= RWLOCK_THREAD_STEP) {
+        list_t list;
+        rw_list_t rw_list;
+        const set_ops_t *ops = kind < 0 ? &set_ops[0] : &rwlock_ops;
+        void *set = kind < 0 ? (void *) &list : (void *) &rw_list;
+        if (kind < 0) {
+          list_init(&list, lock_default_kind(), NULL);
+        } else {
+          rw_list_init(&rw_list, kind);
+        }
+        for (int key = 0; key < MIXED_KEY_RANGE; key += 2) {
+          ops->insert(set, key);
+        }
+
+        for (int i = 0; i < threads; i++) {
+          args[i].ops = ops;
+          args[i].set = set;
+          args[i].seed = i;
+          args[i].count = MIXED_OPS / threads;
+          args[i].read_percent = read_percents[r];
+        }
+        uint64_t elapsed = pool_run(&pool, threads, mixed_start_routine, args, sizeof(mixed_args_t));
+        double ops_per_sec = (double) (MIXED_OPS / threads) * threads * NSEC_IN_SEC / elapsed;
+        fprintf(stdout, "reads: %2d%% %-9s threads: %3d ops/sec: %.0f size: %d\n", read_percents[r],
+          kind < 0 ? lock_kind_name(lock_default_kind()) : rwlock_kind_name(kind), threads, ops_per_sec,
+          list_size(kind < 0 ? &list : &rw_list.list));
+        if (kind >= 0) {
+          rwlock_destroy(&rw_list.lock);
+        }
+      }
+    }
+  }
+
+  pool_destroy(&pool);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "oversubscribe") == 0) {
+    run_oversubscribe_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "mixed") == 0) {
+    fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+    run_mixed_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "rcu") == 0) {
+    fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+    run_rcu_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+    fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+    run_batch_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "rwlock") == 0) {
+    run_rwlock_benchmark();
+    return EXIT_SUCCESS;
+  }
+  if (argc > 1 && strcmp(argv[1], "stripes") == 0) {
+    fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
+    run_stripes_benchmark();
+    return EXIT_SUCCESS;
+  }
+
+  static slab_t slab;
+  slab_init(&slab, sizeof(node_t));
   list_t list;
-  list_init(&list);
+  list_init(&list, lock_default_kind(), NULL);
+  list_t slab_list;
+  list_init(&slab_list, lock_default_kind(), &slab);
+  lf_list_t lf_list;
+  lf_list_init(&lf_list);
+  unrolled_list_t unrolled_list;
+  unrolled_list_init(&unrolled_list, lock_default_kind());
+
+  fprintf(stdout, "lock: %s\n", lock_kind_name(lock_default_kind()));
   
-  timespec_t t1, t2;
   pthread_t threads[THREAD_COUNT];
 
   uint64_t search_times[THREAD_COUNT] = { 0 };
@@ -145,11 +911,33 @@ int main(void) {
   args.iter = 0;
   pthread_mutex_init(&args.iter_lock, NULL);
   args.list = &list;
+  args.lf_list = &lf_list;
+  args.unrolled_list = &unrolled_list;
   args.search_times = search_times;
 
+  timespec_t t1, t2;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
   for (int i = 0; i < NODE_COUNT; i++) {
     prepend_node(&list, i);
   }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  fprintf(stdout, "Time to seed linked list (malloc): %lluns\n", elapsed_nsecs(&t1, &t2));
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+  for (int i = 0; i < NODE_COUNT; i++) {
+    prepend_node(&slab_list, i);
+  }
+  clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
+  fprintf(stdout, "Time to seed linked list (slab): %lluns\n", elapsed_nsecs(&t1, &t2));
+
+  for (int i = 0; i < NODE_COUNT; i++) {
+    unrolled_prepend_node(&unrolled_list, i);
+  }
+
+  // descending so every insert lands at the head of the sorted list
+  for (int i = NODE_COUNT - 1; i >= 0; i--) {
+    lf_insert_node(&lf_list, i);
+  }
 
   for (int i = 0; i < THREAD_COUNT; i++) {
     pthread_create(&threads[i], NULL, hoh_start_routine, &args);
@@ -172,4 +960,66 @@ int main(void) {
   }
   
   fprintf(stdout, "Average time to find last node single locked linked list: %lluns\n", average_cost(search_times, THREAD_COUNT));
+
+  args.iter = 0;
+  args.list = &slab_list;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_create(&threads[i], NULL, single_lock_start_routine, &args);
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  fprintf(stdout, "Average time to find last node single locked linked list (slab): %lluns\n", average_cost(search_times, THREAD_COUNT));
+
+  args.iter = 0;
+  args.list = &list;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_create(&threads[i], NULL, rcu_start_routine, &args);
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  fprintf(stdout, "Average time to find last node rcu linked list: %lluns\n", average_cost(search_times, THREAD_COUNT));
+
+  args.iter = 0;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_create(&threads[i], NULL, lock_free_start_routine, &args);
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  fprintf(stdout, "Average time to find last node lock-free linked list: %lluns\n", average_cost(search_times, THREAD_COUNT));
+
+  args.iter = 0;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_create(&threads[i], NULL, unrolled_hoh_start_routine, &args);
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  fprintf(stdout, "Average time to find last node with HOH unrolled linked list: %lluns\n", average_cost(search_times, THREAD_COUNT));
+
+  args.iter = 0;
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_create(&threads[i], NULL, unrolled_start_routine, &args);
+  }
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  fprintf(stdout, "Average time to find last node single locked unrolled linked list: %lluns\n", average_cost(search_times, THREAD_COUNT));
 }
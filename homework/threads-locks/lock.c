@@ -0,0 +1,594 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "lock.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define SPIN_LIMIT 1024 // spins before giving the cpu away when oversubscribed
+#define FUTEX_MAX_SPIN 1000 // most the adaptive futex lock will spin
+
+#define RWLOCK_WRITER_BIT (1 << 30)
+
+static const char *lock_kind_names[LOCK_KINDS] = { "mutex", "ttas", "ticket", "mcs", "clh", "futex" };
+static const char *rwlock_kind_names[RWLOCK_KINDS] = { "pthread", "reader", "writer", "bigreader" };
+
+// fixed futex spin from LOCK_SPIN, -1 to adapt, -2 until it has been read
+static atomic_int futex_fixed_spin = -2;
+
+static _Thread_local qnode_t *free_qnodes = NULL;
+
+// big reader slot for this thread, -1 until it first reads
+static atomic_int next_rwlock_slot = 0;
+static _Thread_local int rwlock_slot = -1;
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// waiting on a lock whose holder has been descheduled can't finish until
+// it runs again, so past SPIN_LIMIT let it have the cpu
+static void spin(int *spins) {
+  if (++(*spins) < SPIN_LIMIT) {
+    cpu_relax();
+  } else {
+    *spins = 0;
+    sched_yield();
+  }
+}
+
+static qnode_t *qnode_alloc(void) {
+  qnode_t *node = free_qnodes;
+  if (node != NULL) {
+    free_qnodes = node->free_next;
+  } else if ((node = aligned_alloc(CACHE_LINE_SIZE, sizeof(qnode_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+  atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+  return node;
+}
+
+// nodes move between threads with the clh lock, so they go back on
+// whichever thread's list frees them
+static void qnode_free(qnode_t *node) {
+  node->free_next = free_qnodes;
+  free_qnodes = node;
+}
+
+static void futex_wait(atomic_int *addr, int value) {
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+  (void) addr;
+  (void) value;
+  sched_yield();
+#endif
+}
+
+static void futex_wake(atomic_int *addr) {
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+  (void) addr;
+#endif
+}
+
+static int futex_spin_limit(lock_t *lock) {
+  int fixed = atomic_load_explicit(&futex_fixed_spin, memory_order_relaxed);
+  if (fixed == -2) {
+    const char *spin = getenv("LOCK_SPIN");
+    fixed = spin ? atoi(spin) : -1;
+    atomic_store_explicit(&futex_fixed_spin, fixed, memory_order_relaxed);
+  }
+  if (fixed >= 0) {
+    return fixed;
+  }
+  // like glibc's adaptive mutex, allow a bit more than what has been
+  // needed lately so the budget can grow when holders start taking longer
+  int budget = atomic_load_explicit(&lock->futex.spin_budget, memory_order_relaxed);
+  int limit = budget * 2 + 10;
+  return limit < FUTEX_MAX_SPIN ? limit : FUTEX_MAX_SPIN;
+}
+
+static void futex_adapt(lock_t *lock, int spun) {
+  int budget = atomic_load_explicit(&lock->futex.spin_budget, memory_order_relaxed);
+  atomic_store_explicit(&lock->futex.spin_budget, budget + (spun - budget) / 8, memory_order_relaxed);
+}
+
+// spin while the holder is likely still running, then sleep. a sleeper
+// always sets the state to 2 so the holder knows to wake someone
+static void futex_acquire(lock_t *lock) {
+  int expected = 0;
+  if (atomic_compare_exchange_strong_explicit(&lock->futex.state, &expected, 1,
+        memory_order_acquire, memory_order_relaxed)) {
+    return;
+  }
+  int limit = futex_spin_limit(lock);
+  for (int spun = 0; spun < limit; spun++) {
+    cpu_relax();
+    expected = 0;
+    if (atomic_load_explicit(&lock->futex.state, memory_order_relaxed) == 0 &&
+        atomic_compare_exchange_strong_explicit(&lock->futex.state, &expected, 1,
+          memory_order_acquire, memory_order_relaxed)) {
+      futex_adapt(lock, spun);
+      return;
+    }
+  }
+  futex_adapt(lock, limit);
+  while (atomic_exchange_explicit(&lock->futex.state, 2, memory_order_acquire) != 0) {
+    futex_wait(&lock->futex.state, 2);
+  }
+}
+
+static void futex_release(lock_t *lock) {
+  if (atomic_exchange_explicit(&lock->futex.state, 0, memory_order_release) == 2) {
+    futex_wake(&lock->futex.state);
+  }
+}
+
+void lock_init(lock_t *lock, lock_kind_t kind) {
+  lock->kind = kind;
+  switch (kind) {
+    case LOCK_TTAS:
+      atomic_init(&lock->ttas, 0);
+      break;
+    case LOCK_TICKET:
+      atomic_init(&lock->ticket.next, 0);
+      atomic_init(&lock->ticket.serving, 0);
+      break;
+    case LOCK_MCS:
+      atomic_init(&lock->mcs.tail, NULL);
+      lock->mcs.owner = NULL;
+      break;
+    case LOCK_CLH: {
+      // the queue always has a tail, start it with an unlocked node
+      qnode_t *node = qnode_alloc();
+      atomic_store_explicit(&node->locked, 0, memory_order_relaxed);
+      atomic_init(&lock->clh.tail, node);
+      lock->clh.owner = NULL;
+      lock->clh.pred = NULL;
+      atomic_init(&lock->clh.trying, 0);
+      lock->clh.deferred = NULL;
+      break;
+    }
+    case LOCK_FUTEX:
+      atomic_init(&lock->futex.state, 0);
+      atomic_init(&lock->futex.spin_budget, 0);
+      break;
+    default:
+      if ((pthread_mutex_init(&lock->mutex, NULL)) != 0) {
+        fprintf(stderr, "Error initialising mutex.\n");
+        exit(EXIT_FAILURE);
+      }
+      break;
+  }
+}
+
+static void ttas_acquire(lock_t *lock) {
+  int spins = 0;
+  for (;;) {
+    if (!atomic_exchange_explicit(&lock->ttas, 1, memory_order_acquire)) {
+      return;
+    }
+    // spin reading our cached copy until it looks free
+    while (atomic_load_explicit(&lock->ttas, memory_order_relaxed)) {
+      spin(&spins);
+    }
+  }
+}
+
+static void ticket_acquire(lock_t *lock) {
+  int spins = 0;
+  unsigned ticket = atomic_fetch_add_explicit(&lock->ticket.next, 1, memory_order_relaxed);
+  while (atomic_load_explicit(&lock->ticket.serving, memory_order_acquire) != ticket) {
+    spin(&spins);
+  }
+}
+
+static void mcs_acquire(lock_t *lock) {
+  int spins = 0;
+  qnode_t *node = qnode_alloc();
+  qnode_t *pred = atomic_exchange_explicit(&lock->mcs.tail, node, memory_order_acq_rel);
+  if (pred != NULL) {
+    atomic_store_explicit(&pred->next, node, memory_order_release);
+    while (atomic_load_explicit(&node->locked, memory_order_acquire)) {
+      spin(&spins);
+    }
+  }
+  lock->mcs.owner = node;
+}
+
+static void mcs_release(lock_t *lock) {
+  int spins = 0;
+  qnode_t *node = lock->mcs.owner;
+  qnode_t *next = atomic_load_explicit(&node->next, memory_order_acquire);
+  if (next == NULL) {
+    qnode_t *expected = node;
+    if (atomic_compare_exchange_strong_explicit(&lock->mcs.tail, &expected, NULL,
+          memory_order_release, memory_order_relaxed)) {
+      qnode_free(node);
+      return;
+    }
+    // someone swapped in behind us but hasn't linked themselves yet
+    while ((next = atomic_load_explicit(&node->next, memory_order_acquire)) == NULL) {
+      spin(&spins);
+    }
+  }
+  atomic_store_explicit(&next->locked, 0, memory_order_release);
+  qnode_free(node);
+}
+
+static void clh_acquire(lock_t *lock) {
+  int spins = 0;
+  qnode_t *node = qnode_alloc();
+  // seq_cst, paired with the load of trying in clh_release
+  qnode_t *pred = atomic_exchange_explicit(&lock->clh.tail, node, memory_order_seq_cst);
+  while (atomic_load_explicit(&pred->locked, memory_order_acquire)) {
+    spin(&spins);
+  }
+  lock->clh.owner = node;
+  lock->clh.pred = pred;
+}
+
+// our node now belongs to whoever queued behind us, and nobody queued is
+// looking at our predecessor's any more. a try-locker may still have read
+// it as the tail though, and if it were reused and became the tail again
+// that try-locker's cas would succeed with the lock held. so while anyone
+// is trying it waits on the deferred list. only the holder touches that
+// list, which is why this all happens before the next thread is let in
+static void clh_release(lock_t *lock) {
+  qnode_t *node = lock->clh.owner;
+  qnode_t *pred = lock->clh.pred;
+  if (atomic_load_explicit(&lock->clh.trying, memory_order_seq_cst) == 0) {
+    while (lock->clh.deferred != NULL) {
+      qnode_t *deferred = lock->clh.deferred;
+      lock->clh.deferred = deferred->free_next;
+      qnode_free(deferred);
+    }
+    qnode_free(pred);
+  } else {
+    pred->free_next = lock->clh.deferred;
+    lock->clh.deferred = pred;
+  }
+  atomic_store_explicit(&node->locked, 0, memory_order_release);
+}
+
+void lock_acquire(lock_t *lock) {
+  switch (lock->kind) {
+    case LOCK_TTAS:
+      ttas_acquire(lock);
+      break;
+    case LOCK_TICKET:
+      ticket_acquire(lock);
+      break;
+    case LOCK_MCS:
+      mcs_acquire(lock);
+      break;
+    case LOCK_CLH:
+      clh_acquire(lock);
+      break;
+    case LOCK_FUTEX:
+      futex_acquire(lock);
+      break;
+    default:
+      if ((pthread_mutex_lock(&lock->mutex)) != 0) {
+        fprintf(stderr, "Error locking mutex.\n");
+        exit(EXIT_FAILURE);
+      }
+      break;
+  }
+}
+
+// 0 if the lock was taken, like pthread_mutex_trylock
+int lock_try_acquire(lock_t *lock) {
+  switch (lock->kind) {
+    case LOCK_TTAS:
+      if (atomic_load_explicit(&lock->ttas, memory_order_relaxed) ||
+          atomic_exchange_explicit(&lock->ttas, 1, memory_order_acquire)) {
+        return -1;
+      }
+      return 0;
+    case LOCK_TICKET: {
+      unsigned serving = atomic_load_explicit(&lock->ticket.serving, memory_order_relaxed);
+      unsigned expected = serving;
+      return atomic_compare_exchange_strong_explicit(&lock->ticket.next, &expected, serving + 1,
+        memory_order_acquire, memory_order_relaxed) ? 0 : -1;
+    }
+    case LOCK_MCS: {
+      qnode_t *node = qnode_alloc();
+      qnode_t *expected = NULL;
+      if (!atomic_compare_exchange_strong_explicit(&lock->mcs.tail, &expected, node,
+            memory_order_acquire, memory_order_relaxed)) {
+        qnode_free(node);
+        return -1;
+      }
+      lock->mcs.owner = node;
+      return 0;
+    }
+    case LOCK_CLH: {
+      // announce ourselves before reading the tail, so no release can
+      // reuse the node we read until we are done with it
+      atomic_fetch_add_explicit(&lock->clh.trying, 1, memory_order_seq_cst);
+      qnode_t *pred = atomic_load_explicit(&lock->clh.tail, memory_order_seq_cst);
+      if (atomic_load_explicit(&pred->locked, memory_order_acquire)) {
+        atomic_fetch_sub_explicit(&lock->clh.trying, 1, memory_order_release);
+        return -1;
+      }
+      qnode_t *node = qnode_alloc();
+      if (!atomic_compare_exchange_strong_explicit(&lock->clh.tail, &pred, node,
+            memory_order_seq_cst, memory_order_relaxed)) {
+        atomic_fetch_sub_explicit(&lock->clh.trying, 1, memory_order_release);
+        qnode_free(node);
+        return -1;
+      }
+      atomic_fetch_sub_explicit(&lock->clh.trying, 1, memory_order_release);
+      lock->clh.owner = node;
+      lock->clh.pred = pred;
+      return 0;
+    }
+    case LOCK_FUTEX: {
+      int expected = 0;
+      return atomic_compare_exchange_strong_explicit(&lock->futex.state, &expected, 1,
+        memory_order_acquire, memory_order_relaxed) ? 0 : -1;
+    }
+    default:
+      return pthread_mutex_trylock(&lock->mutex);
+  }
+}
+
+void lock_release(lock_t *lock) {
+  switch (lock->kind) {
+    case LOCK_TTAS:
+      atomic_store_explicit(&lock->ttas, 0, memory_order_release);
+      break;
+    case LOCK_TICKET: {
+      unsigned serving = atomic_load_explicit(&lock->ticket.serving, memory_order_relaxed);
+      atomic_store_explicit(&lock->ticket.serving, serving + 1, memory_order_release);
+      break;
+    }
+    case LOCK_MCS:
+      mcs_release(lock);
+      break;
+    case LOCK_CLH:
+      clh_release(lock);
+      break;
+    case LOCK_FUTEX:
+      futex_release(lock);
+      break;
+    default:
+      if ((pthread_mutex_unlock(&lock->mutex)) != 0) {
+        fprintf(stderr, "Error unlocking mutex.\n");
+        exit(EXIT_FAILURE);
+      }
+      break;
+  }
+}
+
+void lock_destroy(lock_t *lock) {
+  switch (lock->kind) {
+    case LOCK_CLH:
+      free(atomic_load(&lock->clh.tail));
+      while (lock->clh.deferred != NULL) {
+        qnode_t *deferred = lock->clh.deferred;
+        lock->clh.deferred = deferred->free_next;
+        free(deferred);
+      }
+      break;
+    case LOCK_MUTEX:
+      pthread_mutex_destroy(&lock->mutex);
+      break;
+    default:
+      break;
+  }
+}
+
+lock_kind_t lock_default_kind(void) {
+  const char *name = getenv("LOCK_KIND");
+  if (name == NULL) {
+    return DEFAULT_LOCK_KIND;
+  }
+  for (int kind = 0; kind < LOCK_KINDS; kind++) {
+    if (strcmp(name, lock_kind_names[kind]) == 0) {
+      return kind;
+    }
+  }
+  fprintf(stderr, "Error unknown LOCK_KIND %s\n", name);
+  exit(EXIT_FAILURE);
+}
+
+const char *lock_kind_name(lock_kind_t kind) {
+  return lock_kind_names[kind];
+}
+
+void rwlock_init(rwlock_t *lock, rwlock_kind_t kind) {
+  lock->kind = kind;
+  switch (kind) {
+    case RWLOCK_READER:
+    case RWLOCK_WRITER:
+      atomic_init(&lock->rw.state, 0);
+      atomic_init(&lock->rw.writers_waiting, 0);
+      break;
+    case RWLOCK_BIG_READER:
+      atomic_init(&lock->br.writer, 0);
+      if ((lock->br.slots = aligned_alloc(CACHE_LINE_SIZE, RWLOCK_SLOTS * sizeof(rwlock_slot_t))) == NULL) {
+        fprintf(stderr, "Error allocating memory.\n");
+        exit(EXIT_FAILURE);
+      }
+      for (int i = 0; i < RWLOCK_SLOTS; i++) {
+        atomic_init(&lock->br.slots[i].readers, 0);
+      }
+      break;
+    default:
+      pthread_rwlock_init(&lock->rwlock, NULL);
+      break;
+  }
+}
+
+// every reader of the reader and writer preferring locks increments the
+// same word, which is the line that bounces between cores
+static void rw_read_acquire(rwlock_t *lock) {
+  int spins = 0;
+  for (;;) {
+    if (lock->kind == RWLOCK_WRITER) {
+      while (atomic_load_explicit(&lock->rw.writers_waiting, memory_order_relaxed) > 0) {
+        spin(&spins);
+      }
+    }
+    int state = atomic_load_explicit(&lock->rw.state, memory_order_relaxed);
+    if ((state & RWLOCK_WRITER_BIT) == 0 &&
+        atomic_compare_exchange_weak_explicit(&lock->rw.state, &state, state + 1,
+          memory_order_acquire, memory_order_relaxed)) {
+      return;
+    }
+    spin(&spins);
+  }
+}
+
+static void rw_write_acquire(rwlock_t *lock) {
+  int spins = 0;
+  if (lock->kind == RWLOCK_WRITER) {
+    atomic_fetch_add_explicit(&lock->rw.writers_waiting, 1, memory_order_relaxed);
+  }
+  for (;;) {
+    int state = 0;
+    if (atomic_load_explicit(&lock->rw.state, memory_order_relaxed) == 0 &&
+        atomic_compare_exchange_weak_explicit(&lock->rw.state, &state, RWLOCK_WRITER_BIT,
+          memory_order_acquire, memory_order_relaxed)) {
+      break;
+    }
+    spin(&spins);
+  }
+  if (lock->kind == RWLOCK_WRITER) {
+    atomic_fetch_sub_explicit(&lock->rw.writers_waiting, 1, memory_order_relaxed);
+  }
+}
+
+static rwlock_slot_t *br_slot(rwlock_t *lock) {
+  if (rwlock_slot < 0) {
+    rwlock_slot = atomic_fetch_add_explicit(&next_rwlock_slot, 1, memory_order_relaxed) % RWLOCK_SLOTS;
+  }
+  return &lock->br.slots[rwlock_slot];
+}
+
+// announce ourselves in our slot, then back out if a writer got there
+// first. both sides are seq_cst so one of them always sees the other
+static void br_read_acquire(rwlock_t *lock) {
+  rwlock_slot_t *slot = br_slot(lock);
+  int spins = 0;
+  for (;;) {
+    atomic_fetch_add(&slot->readers, 1);
+    if (atomic_load(&lock->br.writer) == 0) {
+      return;
+    }
+    atomic_fetch_sub_explicit(&slot->readers, 1, memory_order_release);
+    while (atomic_load_explicit(&lock->br.writer, memory_order_relaxed) != 0) {
+      spin(&spins);
+    }
+  }
+}
+
+static void br_write_acquire(rwlock_t *lock) {
+  int spins = 0;
+  for (;;) {
+    int writer = 0;
+    if (atomic_load_explicit(&lock->br.writer, memory_order_relaxed) == 0 &&
+        atomic_compare_exchange_weak(&lock->br.writer, &writer, 1)) {
+      break;
+    }
+    spin(&spins);
+  }
+  for (int i = 0; i < RWLOCK_SLOTS; i++) {
+    while (atomic_load(&lock->br.slots[i].readers) != 0) {
+      spin(&spins);
+    }
+  }
+}
+
+void rwlock_read_acquire(rwlock_t *lock) {
+  switch (lock->kind) {
+    case RWLOCK_READER:
+    case RWLOCK_WRITER:
+      rw_read_acquire(lock);
+      break;
+    case RWLOCK_BIG_READER:
+      br_read_acquire(lock);
+      break;
+    default:
+      pthread_rwlock_rdlock(&lock->rwlock);
+      break;
+  }
+}
+
+void rwlock_read_release(rwlock_t *lock) {
+  switch (lock->kind) {
+    case RWLOCK_READER:
+    case RWLOCK_WRITER:
+      atomic_fetch_sub_explicit(&lock->rw.state, 1, memory_order_release);
+      break;
+    case RWLOCK_BIG_READER:
+      atomic_fetch_sub_explicit(&br_slot(lock)->readers, 1, memory_order_release);
+      break;
+    default:
+      pthread_rwlock_unlock(&lock->rwlock);
+      break;
+  }
+}
+
+void rwlock_write_acquire(rwlock_t *lock) {
+  switch (lock->kind) {
+    case RWLOCK_READER:
+    case RWLOCK_WRITER:
+      rw_write_acquire(lock);
+      break;
+    case RWLOCK_BIG_READER:
+      br_write_acquire(lock);
+      break;
+    default:
+      pthread_rwlock_wrlock(&lock->rwlock);
+      break;
+  }
+}
+
+void rwlock_write_release(rwlock_t *lock) {
+  switch (lock->kind) {
+    case RWLOCK_READER:
+    case RWLOCK_WRITER:
+      atomic_store_explicit(&lock->rw.state, 0, memory_order_release);
+      break;
+    case RWLOCK_BIG_READER:
+      atomic_store_explicit(&lock->br.writer, 0, memory_order_release);
+      break;
+    default:
+      pthread_rwlock_unlock(&lock->rwlock);
+      break;
+  }
+}
+
+void rwlock_destroy(rwlock_t *lock) {
+  switch (lock->kind) {
+    case RWLOCK_READER:
+    case RWLOCK_WRITER:
+      break;
+    case RWLOCK_BIG_READER:
+      free(lock->br.slots);
+      break;
+    default:
+      pthread_rwlock_destroy(&lock->rwlock);
+      break;
+  }
+}
+
+const char *rwlock_kind_name(rwlock_kind_t kind) {
+  return rwlock_kind_names[kind];
+}
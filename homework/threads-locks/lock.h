@@ -0,0 +1,120 @@
+#ifndef LOCK_H_
+#define LOCK_H_
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// the kind used by lock_default_kind when LOCK_KIND is not set, e.g.
+// gcc -DDEFAULT_LOCK_KIND=LOCK_MCS ...
+#ifndef DEFAULT_LOCK_KIND
+#define DEFAULT_LOCK_KIND LOCK_MUTEX
+#endif
+
+typedef enum lock_kind_t {
+  LOCK_MUTEX,  // pthread_mutex_t
+  LOCK_TTAS,   // test-and-test-and-set spinlock
+  LOCK_TICKET, // fifo spinlock, one counter for waiters, one for the holder
+  LOCK_MCS,    // queue lock, each waiter spins on its own node
+  LOCK_CLH,    // queue lock, each waiter spins on its predecessor's node
+  LOCK_FUTEX,  // spins for a while, then sleeps in the kernel until woken
+  LOCK_KINDS
+} lock_kind_t;
+
+// queue node for the mcs and clh locks. nodes come from a per-thread free
+// list so acquiring a queue lock doesn't need one passed in
+typedef struct qnode_t {
+  _Alignas(CACHE_LINE_SIZE) _Atomic(struct qnode_t *) next;
+  atomic_int locked;
+  struct qnode_t *free_next;
+} qnode_t;
+
+typedef struct lock_t {
+  lock_kind_t kind;
+  union {
+    pthread_mutex_t mutex;
+    atomic_int ttas;
+    struct {
+      atomic_uint next;
+      atomic_uint serving;
+    } ticket;
+    // owner (and pred for clh) are only touched by the thread holding the lock
+    struct {
+      _Atomic(qnode_t *) tail;
+      qnode_t *owner;
+    } mcs;
+    // trying counts lock_try_acquire calls that may have read the tail,
+    // nodes they might still cas against wait on deferred, see clh_release
+    struct {
+      _Atomic(qnode_t *) tail;
+      qnode_t *owner;
+      qnode_t *pred;
+      atomic_int trying;
+      qnode_t *deferred;
+    } clh;
+    // state is 0 unlocked, 1 locked, 2 locked and someone may be asleep.
+    // spin_budget is the running average of spins that got the lock
+    struct {
+      atomic_int state;
+      atomic_int spin_budget;
+    } futex;
+  };
+} lock_t;
+
+typedef enum rwlock_kind_t {
+  RWLOCK_PTHREAD,    // pthread_rwlock_t
+  RWLOCK_READER,     // readers get in whenever no writer holds it
+  RWLOCK_WRITER,     // a waiting writer holds back new readers
+  RWLOCK_BIG_READER, // readers only touch their own slot, writers check every slot
+  RWLOCK_KINDS
+} rwlock_kind_t;
+
+// threads are spread over this many big reader slots
+#ifndef RWLOCK_SLOTS
+#define RWLOCK_SLOTS 64
+#endif
+
+typedef struct rwlock_slot_t {
+  _Alignas(CACHE_LINE_SIZE) atomic_int readers;
+} rwlock_slot_t;
+
+typedef struct rwlock_t {
+  rwlock_kind_t kind;
+  union {
+    pthread_rwlock_t rwlock;
+    // readers in the low bits, RWLOCK_WRITER_BIT while a writer holds it
+    struct {
+      atomic_int state;
+      atomic_int writers_waiting;
+    } rw;
+    struct {
+      atomic_int writer;
+      rwlock_slot_t *slots;
+    } br;
+  };
+} rwlock_t;
+
+void lock_init(lock_t *lock, lock_kind_t kind);
+void lock_acquire(lock_t *lock);
+int lock_try_acquire(lock_t *lock);
+void lock_release(lock_t *lock);
+void lock_destroy(lock_t *lock);
+
+// the LOCK_KIND environment variable (mutex, ttas, ticket, mcs, clh,
+// futex) if set, otherwise DEFAULT_LOCK_KIND. LOCK_SPIN=n fixes how long
+// the futex lock spins before sleeping, by default it adapts per lock
+lock_kind_t lock_default_kind(void);
+const char *lock_kind_name(lock_kind_t kind);
+
+void rwlock_init(rwlock_t *lock, rwlock_kind_t kind);
+void rwlock_read_acquire(rwlock_t *lock);
+void rwlock_read_release(rwlock_t *lock);
+void rwlock_write_acquire(rwlock_t *lock);
+void rwlock_write_release(rwlock_t *lock);
+void rwlock_destroy(rwlock_t *lock);
+const char *rwlock_kind_name(rwlock_kind_t kind);
+
+#endif
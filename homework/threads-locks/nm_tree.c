@@ -0,0 +1,196 @@
+/*
+  Lock-free external binary search tree after Natarajan and Mittal
+  [NM14]. A delete flags the edge to its leaf, then tags the edge to the
+  leaf's sibling so nothing can change below it, and finally swings the
+  nearest untagged edge above straight to the sibling. Anyone who runs
+  into a flagged or tagged edge finishes that delete before going on.
+
+  Every operation is an rcu read-side critical section, and whoever
+  swings the edge hands the nodes it cut off to rcu_free, so no node is
+  freed while an operation may still be on it. rcu_free can't free
+  anything from in there, so inserts and deletes flush after they leave
+  it. The flush never waits on another thread, a stalled reader only
+  delays the freeing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "nm_tree.h"
+#include "rcu.h"
+
+#define FLAG ((uintptr_t) 1)
+#define TAG ((uintptr_t) 2)
+
+#define INF0 (INT_MAX - 2)
+#define INF1 (INT_MAX - 1)
+#define INF2 INT_MAX
+
+// the four nodes at the bottom of a search. successor is the top of the
+// part of the path that a delete will cut off, ancestor is above it
+typedef struct seek_record_t {
+  nm_node_t *ancestor;
+  nm_node_t *successor;
+  nm_node_t *parent;
+  nm_node_t *leaf;
+} seek_record_t;
+
+static nm_node_t *node_ptr(uintptr_t edge) {
+  return (nm_node_t *) (edge & ~(FLAG | TAG));
+}
+
+static nm_node_t *create_node(int key, nm_node_t *left, nm_node_t *right) {
+  nm_node_t *node = NULL;
+  if ((node = malloc(sizeof(nm_node_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  node->key = key;
+  atomic_init(&node->left, (uintptr_t) left);
+  atomic_init(&node->right, (uintptr_t) right);
+  return node;
+}
+
+void nm_tree_init(nm_tree_t *tree) {
+  nm_node_t *s = create_node(INF1, create_node(INF0, NULL, NULL), create_node(INF1, NULL, NULL));
+  tree->root = create_node(INF2, s, create_node(INF2, NULL, NULL));
+}
+
+static atomic_uintptr_t *child_edge(nm_node_t *node, int key) {
+  return key < node->key ? &node->left : &node->right;
+}
+
+static void seek(nm_tree_t *tree, int key, seek_record_t *s) {
+  nm_node_t *sentinel = node_ptr(atomic_load(&tree->root->left));
+  s->ancestor = tree->root;
+  s->successor = sentinel;
+  s->parent = sentinel;
+  uintptr_t parent_edge = atomic_load(&sentinel->left);
+  s->leaf = node_ptr(parent_edge);
+  uintptr_t current_edge = atomic_load(child_edge(s->leaf, key));
+  nm_node_t *current = node_ptr(current_edge);
+  while (current != NULL) {
+    if ((parent_edge & TAG) == 0) {
+      s->ancestor = s->parent;
+      s->successor = s->leaf;
+    }
+    s->parent = s->leaf;
+    s->leaf = current;
+    parent_edge = current_edge;
+    current_edge = atomic_load(child_edge(current, key));
+    current = node_ptr(current_edge);
+  }
+}
+
+// everything below node except keep's subtree has just been cut off
+static void retire(nm_node_t *node, nm_node_t *keep) {
+  if (node == NULL || node == keep) {
+    return;
+  }
+  retire(node_ptr(atomic_load(&node->left)), keep);
+  retire(node_ptr(atomic_load(&node->right)), keep);
+  rcu_free(node);
+}
+
+// finish the delete under s->parent, 1 if this call removed it
+static int cleanup(int key, seek_record_t *s) {
+  atomic_uintptr_t *successor_edge = child_edge(s->ancestor, key);
+  atomic_uintptr_t *leaf_edge = child_edge(s->parent, key);
+  atomic_uintptr_t *sibling_edge = leaf_edge == &s->parent->left ? &s->parent->right : &s->parent->left;
+  // if our leaf isn't the one being deleted, its sibling is
+  if ((atomic_load(leaf_edge) & FLAG) == 0) {
+    sibling_edge = leaf_edge;
+  }
+  uintptr_t sibling = atomic_fetch_or(sibling_edge, TAG) & ~TAG;
+  uintptr_t expected = (uintptr_t) s->successor;
+  if (!atomic_compare_exchange_strong(successor_edge, &expected, sibling)) {
+    return 0;
+  }
+  retire(s->successor, node_ptr(sibling));
+  return 1;
+}
+
+int nm_contains(nm_tree_t *tree, int key) {
+  seek_record_t s;
+  rcu_read_lock();
+  seek(tree, key, &s);
+  int rv = s.leaf->key == key;
+  rcu_read_unlock();
+  return rv;
+}
+
+int nm_insert(nm_tree_t *tree, int key) {
+  nm_node_t *leaf = create_node(key, NULL, NULL);
+  nm_node_t *internal = create_node(key, NULL, NULL);
+  seek_record_t s;
+  int rv = 0;
+  rcu_read_lock();
+  for (;;) {
+    seek(tree, key, &s);
+    if (s.leaf->key == key) {
+      rv = -1;
+      break;
+    }
+    // the new internal node routes between the new leaf and the old one
+    if (key < s.leaf->key) {
+      internal->key = s.leaf->key;
+      atomic_store_explicit(&internal->left, (uintptr_t) leaf, memory_order_relaxed);
+      atomic_store_explicit(&internal->right, (uintptr_t) s.leaf, memory_order_relaxed);
+    } else {
+      internal->key = key;
+      atomic_store_explicit(&internal->left, (uintptr_t) s.leaf, memory_order_relaxed);
+      atomic_store_explicit(&internal->right, (uintptr_t) leaf, memory_order_relaxed);
+    }
+    atomic_uintptr_t *edge = child_edge(s.parent, key);
+    uintptr_t expected = (uintptr_t) s.leaf;
+    if (atomic_compare_exchange_strong(edge, &expected, (uintptr_t) internal)) {
+      break;
+    }
+    if (node_ptr(expected) == s.leaf && (expected & (FLAG | TAG)) != 0) {
+      cleanup(key, &s);
+    }
+  }
+  rcu_read_unlock();
+  rcu_flush();
+  if (rv < 0) {
+    free(leaf);
+    free(internal);
+  }
+  return rv;
+}
+
+int nm_delete(nm_tree_t *tree, int key) {
+  nm_node_t *leaf = NULL;
+  int injecting = 1;
+  seek_record_t s;
+  int rv = 0;
+  rcu_read_lock();
+  for (;;) {
+    seek(tree, key, &s);
+    if (!injecting) {
+      // someone else may have finished our delete for us
+      if (s.leaf != leaf || cleanup(key, &s)) {
+        break;
+      }
+      continue;
+    }
+    leaf = s.leaf;
+    if (leaf->key != key) {
+      rv = -1;
+      break;
+    }
+    atomic_uintptr_t *edge = child_edge(s.parent, key);
+    uintptr_t expected = (uintptr_t) leaf;
+    if (atomic_compare_exchange_strong(edge, &expected, (uintptr_t) leaf | FLAG)) {
+      injecting = 0;
+      if (cleanup(key, &s)) {
+        break;
+      }
+    } else if (node_ptr(expected) == leaf && (expected & (FLAG | TAG)) != 0) {
+      cleanup(key, &s);
+    }
+  }
+  rcu_read_unlock();
+  rcu_flush();
+  return rv;
+}
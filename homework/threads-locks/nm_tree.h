@@ -0,0 +1,28 @@
+#ifndef NM_TREE_H_
+#define NM_TREE_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// keys live in the leaves, internal nodes only route. an edge's low bits
+// say the leaf below is being deleted (flag) or that the edge must not
+// change because its parent is being removed (tag)
+typedef struct nm_node_t {
+  int key;
+  atomic_uintptr_t left;
+  atomic_uintptr_t right;
+} nm_node_t;
+
+// keys must be less than INT_MAX - 2, the top three are sentinels
+typedef struct nm_tree_t {
+  nm_node_t *root;
+} nm_tree_t;
+
+void nm_tree_init(nm_tree_t *tree);
+// 0 on success, -1 if the key was already there / wasn't there
+int nm_insert(nm_tree_t *tree, int key);
+int nm_delete(nm_tree_t *tree, int key);
+// 1 if key is in the tree, 0 otherwise
+int nm_contains(nm_tree_t *tree, int key);
+
+#endif
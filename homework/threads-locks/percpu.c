@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include "percpu.h"
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define HAVE_RSEQ 1
+#endif
+#endif
+
+#ifdef HAVE_RSEQ
+
+// glibc registers an rseq area for every thread it creates, we only find it
+static struct rseq *rseq_area(void) {
+  return (struct rseq *) ((char *) __builtin_thread_pointer() + __rseq_offset);
+}
+
+int percpu_rseq_available(void) {
+  return __rseq_size > 0 && (int32_t) rseq_area()->cpu_id >= 0;
+}
+
+// the critical section is the cpu check and the add. the descriptor tells
+// the kernel where it starts (1), its length (2 - 1) and where to resume
+// if it is interrupted (4), which must follow the rseq signature.
+static int rseq_addv(struct rseq *rs, intptr_t *v, intptr_t count, int cpu) {
+  __asm__ __volatile__ goto (
+    ".pushsection __rseq_cs, \"aw\"\n\t"
+    ".balign 32\n\t"
+    "3:\n\t"
+    ".long 0x0, 0x0\n\t"
+    ".quad 1f, (2f - 1f), 4f\n\t"
+    ".popsection\n\t"
+    "leaq 3b(%%rip), %%rax\n\t"
+    "movq %%rax, %[rseq_cs]\n\t"
+    "1:\n\t"
+    "cmpl %[cpu_id], %[current_cpu_id]\n\t"
+    "jnz %l[abort]\n\t"
+    "addq %[count], %[v]\n\t"
+    "2:\n\t"
+    ".pushsection __rseq_failure, \"ax\"\n\t"
+    ".byte 0x0f, 0xb9, 0x3d\n\t"
+    ".long %c[signature]\n\t"
+    "4:\n\t"
+    "jmp %l[abort]\n\t"
+    ".popsection\n\t"
+    :
+    : [cpu_id] "r" (cpu),
+      [current_cpu_id] "m" (rs->cpu_id),
+      [rseq_cs] "m" (rs->rseq_cs),
+      [v] "m" (*v),
+      [count] "er" (count),
+      [signature] "i" (RSEQ_SIG)
+    : "memory", "cc", "rax"
+    : abort
+  );
+  return 0;
+abort:
+  return -1;
+}
+
+int percpu_current_cpu(void) {
+  if (percpu_rseq_available()) {
+    return (int) rseq_area()->cpu_id;
+  }
+  return sched_getcpu();
+}
+
+int percpu_add(intptr_t *counts, int stride, int cpu_count, intptr_t amount) {
+  if (!percpu_rseq_available()) {
+    return -1;
+  }
+  struct rseq *rs = rseq_area();
+  for (;;) {
+    int cpu = (int) __atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED);
+    if (cpu >= cpu_count) {
+      return -1;
+    }
+    intptr_t *v = (intptr_t *) ((char *) counts + (cpu * stride));
+    if (rseq_addv(rs, v, amount, cpu) == 0) {
+      return cpu;
+    }
+    // preempted, migrated or signalled inside the sequence, try again
+  }
+}
+
+#else
+
+int percpu_rseq_available(void) {
+  return 0;
+}
+
+int percpu_current_cpu(void) {
+#ifdef __linux__
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+int percpu_add(intptr_t *counts, int stride, int cpu_count, intptr_t amount) {
+  (void) counts;
+  (void) stride;
+  (void) cpu_count;
+  (void) amount;
+  return -1;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef PERCPU_H_
+#define PERCPU_H_
+
+#include <stdint.h>
+
+// returns 1 if this thread has a registered restartable sequences area
+int percpu_rseq_available(void);
+
+// cpu the calling thread last ran on, or -1 if the platform can't tell us
+int percpu_current_cpu(void);
+
+// add amount to counts[cpu] for the cpu we are running on, with no atomic
+// instruction or lock. the add is restarted by the kernel if we are
+// preempted or migrated part way through. counts is indexed in steps of
+// stride bytes. returns the cpu used, or -1 if rseq is not available or
+// the cpu is at or beyond cpu_count, in which case nothing was added.
+int percpu_add(intptr_t *counts, int stride, int cpu_count, intptr_t amount);
+
+#endif
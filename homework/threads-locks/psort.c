@@ -0,0 +1,104 @@
+/*
+  Parallel merge sort on a worker pool. The keys are cut into one run per
+  thread and each thread qsorts its run. Then the runs are merged in
+  pairs, each pair by its own thread, halving the number of runs every
+  pass until one is left. The merge passes ping-pong between the keys
+  and a scratch buffer of the same size.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "psort.h"
+
+typedef struct sort_args_t {
+  int *src;
+  int *dst;
+  size_t lo;
+  size_t mid; // the second run starts here, hi when there is only one
+  size_t hi;
+} sort_args_t;
+
+static int compare_keys(const void *a, const void *b) {
+  int x = *(const int *) a;
+  int y = *(const int *) b;
+  return (x > y) - (x < y);
+}
+
+static void *sort_run(void *args) {
+  sort_args_t *a = (sort_args_t *) args;
+  qsort(a->src + a->lo, a->hi - a->lo, sizeof(int), compare_keys);
+  return NULL;
+}
+
+static void *merge_runs(void *args) {
+  sort_args_t *a = (sort_args_t *) args;
+  size_t i = a->lo;
+  size_t j = a->mid;
+  size_t k = a->lo;
+  while (i < a->mid && j < a->hi) {
+    a->dst[k++] = a->src[j] < a->src[i] ? a->src[j++] : a->src[i++];
+  }
+  memcpy(a->dst + k, a->src + i, (a->mid - i) * sizeof(int));
+  k += a->mid - i;
+  memcpy(a->dst + k, a->src + j, (a->hi - j) * sizeof(int));
+  return NULL;
+}
+
+void parallel_sort(worker_pool_t *pool, int threads, int *keys, size_t count) {
+  if (threads < 1 || (size_t) threads > count) {
+    threads = count > 0 ? 1 : 0;
+  }
+  if (threads <= 1) {
+    qsort(keys, count, sizeof(int), compare_keys);
+    return;
+  }
+
+  sort_args_t *args = NULL;
+  size_t *bounds = NULL;
+  int *scratch = NULL;
+  if ((args = malloc(threads * sizeof(sort_args_t))) == NULL ||
+      (bounds = malloc((threads + 1) * sizeof(size_t))) == NULL ||
+      (scratch = malloc(count * sizeof(int))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int runs = threads;
+  for (int i = 0; i <= runs; i++) {
+    bounds[i] = count * i / runs;
+  }
+  for (int i = 0; i < runs; i++) {
+    args[i].src = keys;
+    args[i].lo = bounds[i];
+    args[i].hi = bounds[i + 1];
+  }
+  pool_run(pool, runs, sort_run, args, sizeof(sort_args_t));
+
+  int *src = keys;
+  int *dst = scratch;
+  while (runs > 1) {
+    int merges = (runs + 1) / 2;
+    for (int i = 0; i < merges; i++) {
+      args[i].src = src;
+      args[i].dst = dst;
+      args[i].lo = bounds[2 * i];
+      args[i].mid = 2 * i + 1 < runs ? bounds[2 * i + 1] : bounds[runs];
+      args[i].hi = 2 * i + 2 < runs ? bounds[2 * i + 2] : bounds[runs];
+      bounds[i] = args[i].lo;
+    }
+    bounds[merges] = count;
+    pool_run(pool, merges, merge_runs, args, sizeof(sort_args_t));
+    runs = merges;
+    int *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != keys) {
+    memcpy(keys, src, count * sizeof(int));
+  }
+  free(scratch);
+  free(bounds);
+  free(args);
+}
@@ -0,0 +1,11 @@
+#ifndef PSORT_H_
+#define PSORT_H_
+
+#include <stddef.h>
+#include "worker_pool.h"
+
+// sorts keys ascending using the first threads workers of pool, each
+// sorts a run of its own and the runs are then merged in pairs
+void parallel_sort(worker_pool_t *pool, int threads, int *keys, size_t count);
+
+#endif
@@ -0,0 +1,195 @@
+/*
+  Minimal user space read-copy-update, in the style of the memory barrier
+  flavour of liburcu [DMS+12]. A reader publishes the grace period it
+  started in, a writer starts a new grace period and waits for every
+  reader still in an older one to leave.
+
+  rcu_free never waits like that. Each retired pointer is tagged with the
+  grace period it was retired in, and a flush only advances the period
+  when no reader is still in an older one, in the style of epoch based
+  reclamation [Fra04]. A pointer is freed once the period has moved on
+  twice since it was retired. A reader that stalls only holds back the
+  freeing, never the thread doing it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "rcu.h"
+
+#ifndef RCU_FREE_BATCH
+#define RCU_FREE_BATCH 256
+#endif
+
+// readers are heap allocated rather than thread local so the registry
+// never points at a thread that has exited, an idle reader just stays 0
+typedef struct rcu_reader_t {
+  atomic_ulong period; // grace period entered in, 0 when not reading
+  int nesting;
+  struct rcu_reader_t *next;
+} rcu_reader_t;
+
+static atomic_ulong rcu_period = 1;
+static _Atomic(rcu_reader_t *) rcu_readers = NULL;
+static pthread_mutex_t rcu_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local rcu_reader_t *rcu_self = NULL;
+
+// a pointer passed to rcu_free and the grace period it was retired in
+typedef struct rcu_retired_t {
+  void *ptr;
+  unsigned long period;
+} rcu_retired_t;
+
+// pointers this thread has passed to rcu_free that may still be in use,
+// oldest first, and the count at which the next flush tries to free some
+static _Thread_local rcu_retired_t *rcu_pending = NULL;
+static _Thread_local int rcu_pending_count = 0;
+static _Thread_local int rcu_pending_capacity = 0;
+static _Thread_local int rcu_next_flush = RCU_FREE_BATCH;
+
+// set on threads with something pending so rcu_thread_exit runs for them
+static pthread_key_t rcu_exit_key;
+static pthread_once_t rcu_exit_once = PTHREAD_ONCE_INIT;
+
+static rcu_reader_t *rcu_register(void) {
+  rcu_reader_t *reader = NULL;
+  if ((reader = malloc(sizeof(rcu_reader_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  atomic_init(&reader->period, 0);
+  reader->nesting = 0;
+  reader->next = atomic_load_explicit(&rcu_readers, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&rcu_readers, &reader->next, reader,
+           memory_order_release, memory_order_relaxed)) {
+  }
+  rcu_self = reader;
+  return reader;
+}
+
+void rcu_read_lock(void) {
+  rcu_reader_t *reader = rcu_self ? rcu_self : rcu_register();
+  if (reader->nesting++ == 0) {
+    atomic_store_explicit(&reader->period, atomic_load_explicit(&rcu_period, memory_order_relaxed), memory_order_relaxed);
+    // the period must be visible before we read anything it protects
+    atomic_thread_fence(memory_order_seq_cst);
+  }
+}
+
+void rcu_read_unlock(void) {
+  rcu_reader_t *reader = rcu_self;
+  if (--reader->nesting == 0) {
+    atomic_store_explicit(&reader->period, 0, memory_order_release);
+  }
+}
+
+void rcu_synchronize(void) {
+  // pairs with the reader's fence, either it sees our unlink or we see it
+  atomic_thread_fence(memory_order_seq_cst);
+  pthread_mutex_lock(&rcu_writer_lock);
+  unsigned long period = atomic_fetch_add(&rcu_period, 1) + 1;
+  for (rcu_reader_t *reader = atomic_load_explicit(&rcu_readers, memory_order_acquire); reader; reader = reader->next) {
+    for (;;) {
+      unsigned long entered = atomic_load_explicit(&reader->period, memory_order_acquire);
+      if (entered == 0 || entered >= period) {
+        break;
+      }
+      sched_yield();
+    }
+  }
+  pthread_mutex_unlock(&rcu_writer_lock);
+}
+
+// move the grace period on by one if no reader is still in an older one,
+// without waiting for anyone. returns the period afterwards
+static unsigned long rcu_try_advance(void) {
+  // pairs with the reader's fence, either we see its period or it sees
+  // every unlink made before the period moved on
+  atomic_thread_fence(memory_order_seq_cst);
+  unsigned long period = atomic_load(&rcu_period);
+  for (rcu_reader_t *reader = atomic_load_explicit(&rcu_readers, memory_order_acquire); reader; reader = reader->next) {
+    unsigned long entered = atomic_load_explicit(&reader->period, memory_order_acquire);
+    if (entered != 0 && entered < period) {
+      return period;
+    }
+  }
+  // losing the race means someone else moved it on, which is as good
+  if (atomic_compare_exchange_strong(&rcu_period, &period, period + 1)) {
+    period++;
+  }
+  return period;
+}
+
+// free the pending pointers whose grace period is over, two periods back.
+// a reader in the period a pointer was retired in, or the one before it,
+// might still see it, and the period can't move past those readers
+static void rcu_free_expired(unsigned long period) {
+  int freed = 0;
+  while (freed < rcu_pending_count && rcu_pending[freed].period + 2 <= period) {
+    free(rcu_pending[freed++].ptr);
+  }
+  for (int i = freed; i < rcu_pending_count; i++) {
+    rcu_pending[i - freed] = rcu_pending[i];
+  }
+  rcu_pending_count -= freed;
+}
+
+static void rcu_free_pending(void) {
+  rcu_synchronize();
+  rcu_synchronize();
+  rcu_free_expired(atomic_load(&rcu_period));
+}
+
+// a thread is never inside a read-side critical section when it exits,
+// so it can wait out the grace periods its pending pointers need. this is
+// the one place a free waits, and only on the exiting thread
+static void rcu_thread_exit(void *unused) {
+  (void) unused;
+  if (rcu_pending_count > 0) {
+    rcu_free_pending();
+  }
+  free(rcu_pending);
+  rcu_pending = NULL;
+  rcu_pending_capacity = 0;
+}
+
+static void rcu_exit_key_create(void) {
+  pthread_key_create(&rcu_exit_key, rcu_thread_exit);
+}
+
+void rcu_flush(void) {
+  if (rcu_pending_count >= rcu_next_flush && !(rcu_self && rcu_self->nesting > 0)) {
+    rcu_free_expired(rcu_try_advance());
+    // a stalled reader can keep everything pending, so try again after
+    // another batch rather than on every call
+    rcu_next_flush = rcu_pending_count + RCU_FREE_BATCH;
+  }
+}
+
+void rcu_free(void *ptr) {
+  if (rcu_pending == NULL) {
+    pthread_once(&rcu_exit_once, rcu_exit_key_create);
+    pthread_setspecific(rcu_exit_key, &rcu_exit_key);
+  }
+  if (rcu_pending_count == rcu_pending_capacity) {
+    int capacity = rcu_pending_capacity ? rcu_pending_capacity * 2 : RCU_FREE_BATCH;
+    rcu_retired_t *pending = realloc(rcu_pending, capacity * sizeof(rcu_retired_t));
+    if (pending == NULL) {
+      fprintf(stderr, "Error allocating memory.\n");
+      exit(EXIT_FAILURE);
+    }
+    rcu_pending = pending;
+    rcu_pending_capacity = capacity;
+  }
+  // the unlink must come before the period we tag it with, see
+  // rcu_try_advance
+  atomic_thread_fence(memory_order_seq_cst);
+  rcu_pending[rcu_pending_count].ptr = ptr;
+  rcu_pending[rcu_pending_count].period = atomic_load(&rcu_period);
+  rcu_pending_count++;
+  // freeing from inside a read-side critical section could free what we
+  // are still on, rcu_flush checks for that
+  rcu_flush();
+}
@@ -0,0 +1,26 @@
+#ifndef RCU_H_
+#define RCU_H_
+
+// read-side critical sections nest and never block. a thread is registered
+// the first time it enters one
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+
+// wait until every read-side critical section that was running when this
+// was called has finished, after which anything unlinked before the call
+// can be freed
+void rcu_synchronize(void);
+
+// free ptr once every reader that might still see it has left. never
+// waits for a reader, the pointer is held until a later call finds its
+// grace period over, and nothing is freed inside a read-side critical
+// section
+void rcu_free(void *ptr);
+// that later call, for code that calls rcu_free from inside a read-side
+// critical section. once another RCU_FREE_BATCH pointers have built up it
+// moves the grace period on if no reader is behind it and frees what has
+// expired, without waiting. whatever a thread still has pending when it
+// exits is freed then
+void rcu_flush(void);
+
+#endif
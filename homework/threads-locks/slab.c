@@ -0,0 +1,133 @@
+/*
+  Slab allocator for fixed size objects [Bon94]. Each thread allocates
+  from its own cache, first reusing objects it freed and then bumping
+  through a chunk of SLAB_CHUNK_OBJECTS it was given. The slab lock is
+  only taken to hand out a new chunk or move freed objects between
+  threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "slab.h"
+
+static atomic_int next_slab_id = 1;
+
+// cache this thread uses, valid while slab_cache_id matches the slab
+static _Thread_local int slab_cache_id = 0;
+static _Thread_local slab_cache_t *slab_cache = NULL;
+
+static void *next_object(void *object) {
+  return *(void **) object;
+}
+
+static void set_next_object(void *object, void *next) {
+  *(void **) object = next;
+}
+
+void slab_init(slab_t *slab, size_t object_size) {
+  // room for the free list link, and every object starts suitably aligned
+  if (object_size < sizeof(void *)) {
+    object_size = sizeof(void *);
+  }
+  size_t align = _Alignof(max_align_t);
+  slab->object_size = (object_size + align - 1) / align * align;
+  slab->id = atomic_fetch_add(&next_slab_id, 1);
+  pthread_mutex_init(&slab->lock, NULL);
+  slab->free = NULL;
+  slab->chunks = NULL;
+  atomic_init(&slab->cache_count, 0);
+  for (int i = 0; i < SLAB_CACHE_COUNT; i++) {
+    slab->caches[i].free = NULL;
+    slab->caches[i].free_count = 0;
+    slab->caches[i].next = NULL;
+    slab->caches[i].end = NULL;
+  }
+}
+
+static slab_cache_t *get_cache(slab_t *slab) {
+  if (slab_cache_id != slab->id) {
+    int cache = atomic_fetch_add(&slab->cache_count, 1);
+    if (cache >= SLAB_CACHE_COUNT) {
+      fprintf(stderr, "Error more than %d threads using slab\n", SLAB_CACHE_COUNT);
+      exit(EXIT_FAILURE);
+    }
+    slab_cache = &slab->caches[cache];
+    slab_cache_id = slab->id;
+  }
+  return slab_cache;
+}
+
+// take back up to half a cache's worth of freed objects, otherwise a new
+// chunk. caller holds the slab lock
+static void refill_cache(slab_t *slab, slab_cache_t *cache) {
+  while (slab->free && cache->free_count < SLAB_CACHE_LIMIT / 2) {
+    void *object = slab->free;
+    slab->free = next_object(object);
+    set_next_object(object, cache->free);
+    cache->free = object;
+    cache->free_count++;
+  }
+  if (cache->free) {
+    return;
+  }
+  char *chunk = NULL;
+  if (posix_memalign((void **) &chunk, CACHE_LINE_SIZE, CACHE_LINE_SIZE + slab->object_size * SLAB_CHUNK_OBJECTS) != 0) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  set_next_object(chunk, slab->chunks);
+  slab->chunks = chunk;
+  cache->next = chunk + CACHE_LINE_SIZE;
+  cache->end = cache->next + slab->object_size * SLAB_CHUNK_OBJECTS;
+}
+
+void *slab_alloc(slab_t *slab) {
+  slab_cache_t *cache = get_cache(slab);
+  if (cache->free == NULL && cache->next == cache->end) {
+    pthread_mutex_lock(&slab->lock);
+    refill_cache(slab, cache);
+    pthread_mutex_unlock(&slab->lock);
+  }
+  void *object = NULL;
+  if (cache->free) {
+    object = cache->free;
+    cache->free = next_object(object);
+    cache->free_count--;
+  } else {
+    object = cache->next;
+    cache->next += slab->object_size;
+  }
+  return object;
+}
+
+void slab_free(slab_t *slab, void *object) {
+  slab_cache_t *cache = get_cache(slab);
+  set_next_object(object, cache->free);
+  cache->free = object;
+  if (++cache->free_count < SLAB_CACHE_LIMIT) {
+    return;
+  }
+  // give the whole cache back so threads that only allocate can reuse it
+  void *last = cache->free;
+  while (next_object(last)) {
+    last = next_object(last);
+  }
+  pthread_mutex_lock(&slab->lock);
+  set_next_object(last, slab->free);
+  slab->free = cache->free;
+  pthread_mutex_unlock(&slab->lock);
+  cache->free = NULL;
+  cache->free_count = 0;
+}
+
+void slab_destroy(slab_t *slab) {
+  void *chunk = slab->chunks;
+  while (chunk) {
+    void *next = next_object(chunk);
+    free(chunk);
+    chunk = next;
+  }
+  slab->chunks = NULL;
+  slab->free = NULL;
+  pthread_mutex_destroy(&slab->lock);
+}
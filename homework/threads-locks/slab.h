@@ -0,0 +1,56 @@
+#ifndef SLAB_H_
+#define SLAB_H_
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// most threads that can have their own cache in one slab
+#ifndef SLAB_CACHE_COUNT
+#define SLAB_CACHE_COUNT 1024
+#endif
+
+// objects in each bulk allocation, handed out to one thread in order so
+// objects it allocates one after another sit next to each other
+#ifndef SLAB_CHUNK_OBJECTS
+#define SLAB_CHUNK_OBJECTS 4096
+#endif
+
+// a thread frees up to this many objects into its own cache before
+// handing them back to the slab
+#ifndef SLAB_CACHE_LIMIT
+#define SLAB_CACHE_LIMIT 1024
+#endif
+
+// only the owning thread touches its cache
+typedef struct slab_cache_t {
+  _Alignas(CACHE_LINE_SIZE) void *free; // linked through each object's first word
+  int free_count;
+  char *next; // what is left of this thread's current chunk
+  char *end;
+} slab_cache_t;
+
+// fixed size objects carved out of large chunks. a thread keeps one cache
+// per slab it is using, switching back and forth between slabs claims a
+// new cache every time, so use one slab per object type
+typedef struct slab_t {
+  int id;
+  size_t object_size;
+  pthread_mutex_t lock;
+  void *free;   // objects returned by caches that grew past SLAB_CACHE_LIMIT
+  void *chunks; // every chunk, linked through its first cache line
+  atomic_int cache_count;
+  slab_cache_t caches[SLAB_CACHE_COUNT];
+} slab_t;
+
+void slab_init(slab_t *slab, size_t object_size);
+void *slab_alloc(slab_t *slab);
+void slab_free(slab_t *slab, void *object);
+// frees every chunk, nothing allocated from the slab may be used after
+void slab_destroy(slab_t *slab);
+
+#endif
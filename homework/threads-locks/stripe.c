@@ -0,0 +1,89 @@
+/*
+  Lock striping. Giving every node its own lock costs a lock_t per node,
+  48 bytes with a pthread mutex, where the node itself may only hold a
+  key and a pointer. Most of those locks are never contended at the same
+  time, so nodes share a fixed number of locks instead, picked by hashing
+  the node's address. Each stripe has its own cache line so threads on
+  different stripes do not slow each other down.
+
+  The catch is that holding one node's lock now holds every node on the
+  same stripe, so code that takes a second lock while holding one can
+  deadlock where it could not with a lock per node. stripe_couple never
+  blocks or yields while holding a stripe, since anyone queued behind it
+  would wait out the yield too. It retries a busy stripe a few times,
+  then lets go of its own and waits for the busy one holding nothing, and
+  the caller starts over.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "stripe.h"
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+void stripes_init(stripes_t *stripes, int count, lock_kind_t kind) {
+  if (count < 1 || (count & (count - 1)) != 0) {
+    fprintf(stderr, "Error stripe count %d is not a power of two\n", count);
+    exit(EXIT_FAILURE);
+  }
+  if ((stripes->stripes = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(stripe_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory\n");
+    exit(EXIT_FAILURE);
+  }
+  stripes->count = count;
+  stripes->shift = 64;
+  while ((1 << (64 - stripes->shift)) < count) {
+    stripes->shift--;
+  }
+  for (int i = 0; i < count; i++) {
+    lock_init(&stripes->stripes[i].lock, kind);
+  }
+}
+
+// fibonacci hashing, so nodes allocated next to each other still spread
+// over every stripe
+lock_t *stripe_lock(stripes_t *stripes, const void *addr) {
+  if (stripes->count == 1) {
+    return &stripes->stripes[0].lock;
+  }
+  uint64_t hash = ((uintptr_t) addr >> 4) * 0x9e3779b97f4a7c15ull;
+  return &stripes->stripes[hash >> stripes->shift].lock;
+}
+
+lock_t *stripe_couple(stripes_t *stripes, lock_t *held, const void *next) {
+  lock_t *lock = stripe_lock(stripes, next);
+  if (lock == held) {
+    return held;
+  }
+  for (int i = 0; i < STRIPE_TRIES; i++) {
+    if (lock_try_acquire(lock) == 0) {
+      lock_release(held);
+      return lock;
+    }
+    cpu_relax();
+  }
+  // holding nothing we can't deadlock, so wait until the stripe is free
+  // rather than restart straight into it
+  lock_release(held);
+  lock_acquire(lock);
+  lock_release(lock);
+  return NULL;
+}
+
+size_t stripes_memory(stripes_t *stripes) {
+  return stripes->count * sizeof(stripe_t);
+}
+
+void stripes_destroy(stripes_t *stripes) {
+  for (int i = 0; i < stripes->count; i++) {
+    lock_destroy(&stripes->stripes[i].lock);
+  }
+  free(stripes->stripes);
+}
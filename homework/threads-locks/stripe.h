@@ -0,0 +1,36 @@
+#ifndef STRIPE_H_
+#define STRIPE_H_
+
+#include <stddef.h>
+#include "lock.h"
+
+// how many times stripe_couple tries a busy stripe before giving up
+#ifndef STRIPE_TRIES
+#define STRIPE_TRIES 4
+#endif
+
+typedef struct stripe_t {
+  _Alignas(CACHE_LINE_SIZE) lock_t lock;
+} stripe_t;
+
+// a fixed table of locks shared by any number of objects, each object
+// uses the stripe its address hashes to
+typedef struct stripes_t {
+  stripe_t *stripes;
+  int count; // a power of two
+  int shift; // 64 - log2(count), see stripe_lock
+} stripes_t;
+
+void stripes_init(stripes_t *stripes, int count, lock_kind_t kind);
+lock_t *stripe_lock(stripes_t *stripes, const void *addr);
+// hand-over-hand from held to the stripe of next, keeping held if next
+// hashes to it. two objects can share a stripe, so waiting here could
+// deadlock with a thread coming the other way; instead it tries
+// STRIPE_TRIES times, then releases held, waits for next's stripe to be
+// free and returns NULL for the caller to start over
+lock_t *stripe_couple(stripes_t *stripes, lock_t *held, const void *next);
+// bytes of the lock table
+size_t stripes_memory(stripes_t *stripes);
+void stripes_destroy(stripes_t *stripes);
+
+#endif
@@ -2,6 +2,7 @@
 #define TIMER_H_
 
 #include <time.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 typedef struct timespec timespec_t;
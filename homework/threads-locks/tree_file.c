@@ -0,0 +1,89 @@
+/*
+  On-disk snapshot of a binary search tree. The file is a header and the
+  node array, with children as indexes into that array instead of
+  pointers, so opening it is a single mmap and the first search can start
+  right away. The kernel pages the file in as the search touches it, a
+  lookup reads about one page per level until the top of the tree is
+  cached.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tree_file.h"
+
+#define TREE_FILE_MAGIC 0x45455254 // "TREE"
+#define TREE_FILE_VERSION 1
+
+void tree_file_save(const char *path, const tree_file_node_t *nodes, uint32_t count, uint32_t root) {
+  FILE *out = NULL;
+  if ((out = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, "Error opening %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  tree_file_header_t header = { TREE_FILE_MAGIC, TREE_FILE_VERSION, count, root };
+  // nodes[0] is written too, so an index is simply a position in the array
+  tree_file_node_t unused = { 0, 0, 0 };
+  if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+      fwrite(&unused, sizeof(unused), 1, out) != 1 ||
+      fwrite(nodes + 1, sizeof(tree_file_node_t), count, out) != count ||
+      fclose(out) != 0) {
+    fprintf(stderr, "Error writing %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+}
+
+void tree_file_open(tree_file_t *file, const char *path) {
+  int fd = -1;
+  struct stat st;
+  if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "Error opening %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  file->size = st.st_size;
+  if (file->size < sizeof(tree_file_header_t) + sizeof(tree_file_node_t)) {
+    fprintf(stderr, "Error %s is not a tree file\n", path);
+    exit(EXIT_FAILURE);
+  }
+  if ((file->map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+    fprintf(stderr, "Error mapping %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+
+  const tree_file_header_t *header = file->map;
+  if (header->magic != TREE_FILE_MAGIC || header->version != TREE_FILE_VERSION ||
+      file->size != sizeof(tree_file_header_t) + ((size_t) header->count + 1) * sizeof(tree_file_node_t) ||
+      header->root > header->count) {
+    fprintf(stderr, "Error %s is not a tree file\n", path);
+    exit(EXIT_FAILURE);
+  }
+  file->count = header->count;
+  file->root = header->root;
+  // nodes[0] is the unused node straight after the header
+  file->nodes = (const tree_file_node_t *) ((const char *) file->map + sizeof(tree_file_header_t));
+}
+
+int tree_file_contains(const tree_file_t *file, int key) {
+  uint32_t index = file->root;
+  // a damaged file could send us in circles, no path is longer than count
+  for (uint32_t depth = 0; index != 0 && depth < file->count; depth++) {
+    if (index > file->count) {
+      fprintf(stderr, "Error tree file node %u is out of range\n", index);
+      exit(EXIT_FAILURE);
+    }
+    const tree_file_node_t *node = &file->nodes[index];
+    if (node->key == key) {
+      return 1;
+    }
+    index = node->key < key ? node->left : node->right;
+  }
+  return 0;
+}
+
+void tree_file_close(tree_file_t *file) {
+  munmap(file->map, file->size);
+}
@@ -0,0 +1,40 @@
+#ifndef TREE_FILE_H_
+#define TREE_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// children are indexes into the file's node array, 0 is no child, so the
+// file means the same wherever it is mapped. larger keys go left, the
+// same as binary_tree. written in the byte order of the machine
+typedef struct tree_file_node_t {
+  int key;
+  uint32_t left;
+  uint32_t right;
+} tree_file_node_t;
+
+typedef struct tree_file_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count; // nodes[1] to nodes[count] follow the header
+  uint32_t root;
+} tree_file_header_t;
+
+// a snapshot mapped read-only, nothing is read from disk until a
+// search touches it
+typedef struct tree_file_t {
+  void *map;
+  size_t size;
+  uint32_t count;
+  uint32_t root;
+  const tree_file_node_t *nodes;
+} tree_file_t;
+
+// nodes[0] is ignored, like in the file
+void tree_file_save(const char *path, const tree_file_node_t *nodes, uint32_t count, uint32_t root);
+void tree_file_open(tree_file_t *file, const char *path);
+// 1 if key is in the snapshot, 0 otherwise
+int tree_file_contains(const tree_file_t *file, int key);
+void tree_file_close(tree_file_t *file);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+  Unrolled linked list [SRA94]. Each node holds a cache line of keys,
+  which are compared against the one we are looking for all at once with
+  AVX2 or SSE2 when the compiler targets them (gcc -mavx2 ...), and one
+  at a time otherwise. A walk takes one cache miss per UNROLLED_KEYS keys
+  instead of one per key.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "unrolled_list.h"
+
+static unrolled_node_t *create_node(unrolled_list_t *list, unrolled_node_t *next) {
+  unrolled_node_t *node = NULL;
+  if (posix_memalign((void **) &node, CACHE_LINE_SIZE, sizeof(unrolled_node_t)) != 0) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  memset(node->keys, 0, sizeof(node->keys));
+  node->count = 0;
+  node->next = next;
+  lock_init(&node->lock, list->kind);
+  return node;
+}
+
+// the whole line is compared, matches past count are masked off
+static int node_contains(const unrolled_node_t *node, int key) {
+  unsigned int matches = 0;
+#if defined(__AVX2__)
+  __m256i needle = _mm256_set1_epi32(key);
+  for (int i = 0; i < UNROLLED_KEYS; i += 8) {
+    __m256i keys = _mm256_load_si256((const __m256i *) &node->keys[i]);
+    matches |= (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(keys, needle))) << i;
+  }
+#elif defined(__SSE2__)
+  __m128i needle = _mm_set1_epi32(key);
+  for (int i = 0; i < UNROLLED_KEYS; i += 4) {
+    __m128i keys = _mm_load_si128((const __m128i *) &node->keys[i]);
+    matches |= (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(keys, needle))) << i;
+  }
+#else
+  for (int i = 0; i < node->count; i++) {
+    matches |= (unsigned int) (node->keys[i] == key) << i;
+  }
+#endif
+  return (matches & ((1u << node->count) - 1)) != 0;
+}
+
+void unrolled_list_init(unrolled_list_t *list, lock_kind_t kind) {
+  list->head = NULL;
+  list->kind = kind;
+  lock_init(&list->lock, kind);
+}
+
+// the head's lock is held while its keys change so a hand-over-hand
+// lookup standing on it never sees a half written key
+int unrolled_prepend_node(unrolled_list_t *list, int key) {
+  lock_acquire(&list->lock);
+  unrolled_node_t *head = list->head;
+  if (head == NULL || head->count == UNROLLED_KEYS) {
+    head = create_node(list, head);
+    list->head = head;
+  }
+  lock_acquire(&head->lock);
+  head->keys[head->count++] = key;
+  lock_release(&head->lock);
+  lock_release(&list->lock);
+  return 0;
+}
+
+int unrolled_lookup_node(unrolled_list_t *list, int key) {
+  int rv = -1;
+  lock_acquire(&list->lock);
+  for (unrolled_node_t *curr = list->head; curr; curr = curr->next) {
+    if (node_contains(curr, key)) {
+      rv = 0;
+      break;
+    }
+  }
+  lock_release(&list->lock);
+  return rv;
+}
+
+int unrolled_hoh_lookup_node(unrolled_list_t *list, int key) {
+  int rv = -1;
+  lock_acquire(&list->lock);
+  unrolled_node_t *curr = list->head;
+  if (curr) {
+    lock_acquire(&curr->lock);
+  }
+  lock_release(&list->lock);
+  while (curr) {
+    if (node_contains(curr, key)) {
+      rv = 0;
+      lock_release(&curr->lock);
+      break;
+    }
+    unrolled_node_t *next = curr->next;
+    if (next) {
+      lock_acquire(&next->lock);
+    }
+    lock_release(&curr->lock);
+    curr = next;
+  }
+  return rv;
+}
@@ -0,0 +1,32 @@
+#ifndef UNROLLED_LIST_H_
+#define UNROLLED_LIST_H_
+
+#include "lock.h"
+
+// keys held by one node, a cache line of them
+#define UNROLLED_KEYS ((int) (CACHE_LINE_SIZE / sizeof(int)))
+
+// keys[0..count) are in use, the rest are 0
+typedef struct unrolled_node_t {
+  _Alignas(CACHE_LINE_SIZE) int keys[UNROLLED_KEYS];
+  int count;
+  struct unrolled_node_t *next;
+  lock_t lock;
+} unrolled_node_t;
+
+// keys are added to the head node until it is full, then a new node is
+// prepended. the list lock and every node lock are kind
+typedef struct unrolled_list_t {
+  unrolled_node_t *head;
+  lock_t lock;
+  lock_kind_t kind;
+} unrolled_list_t;
+
+void unrolled_list_init(unrolled_list_t *list, lock_kind_t kind);
+int unrolled_prepend_node(unrolled_list_t *list, int key);
+// holds the list lock for the whole walk
+int unrolled_lookup_node(unrolled_list_t *list, int key);
+// hand-over-hand through the node locks
+int unrolled_hoh_lookup_node(unrolled_list_t *list, int key);
+
+#endif
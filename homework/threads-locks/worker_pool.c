@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "worker_pool.h"
+
+#ifndef WAIT_SPIN_LIMIT
+#define WAIT_SPIN_LIMIT 1024 // spins at the release point before yielding
+#endif
+
+static int timespec_before(timespec_t *a, timespec_t *b) {
+  return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// with more active workers than cpus some of them are waiting for a cpu,
+// so past WAIT_SPIN_LIMIT let them have it
+static void spin(int *spins) {
+  if (++(*spins) < WAIT_SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+  } else {
+    *spins = 0;
+    sched_yield();
+  }
+}
+
+static void *worker_routine(void *args) {
+  worker_t *w = (worker_t *) args;
+  worker_pool_t *pool = w->pool;
+  uint64_t generation = 0;
+  for (;;) {
+    pthread_mutex_lock(&w->lock);
+    while (w->generation == generation) {
+      pthread_cond_wait(&w->cond, &w->lock);
+    }
+    generation = w->generation;
+    pthread_mutex_unlock(&w->lock);
+    if (pool->shutdown) {
+      break;
+    }
+
+    atomic_fetch_add(&pool->ready, 1);
+    int spins = 0;
+    while (atomic_load_explicit(&pool->release, memory_order_acquire) != generation) {
+      spin(&spins);
+    }
+    pool->routine((char *) pool->args + (w->id * pool->arg_size));
+    clock_gettime(CLOCK_MONOTONIC_RAW, &w->end);
+
+    if (atomic_fetch_sub(&pool->running, 1) == 1) {
+      pthread_mutex_lock(&pool->done_lock);
+      pthread_cond_signal(&pool->done_cond);
+      pthread_mutex_unlock(&pool->done_lock);
+    }
+  }
+  return NULL;
+}
+
+static void wake_worker(worker_t *w, uint64_t generation) {
+  pthread_mutex_lock(&w->lock);
+  w->generation = generation;
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->lock);
+}
+
+void pool_init(worker_pool_t *pool, int thread_count) {
+  int rv = 0;
+  pool->thread_count = thread_count;
+  pool->active_count = 0;
+  pool->shutdown = 0;
+  pool->generation = 0;
+  atomic_init(&pool->ready, 0);
+  atomic_init(&pool->release, 0);
+  atomic_init(&pool->running, 0);
+  pthread_mutex_init(&pool->done_lock, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+  pool->routine = NULL;
+  pool->args = NULL;
+  pool->arg_size = 0;
+  if ((pool->threads = malloc(thread_count * sizeof(pthread_t))) == NULL ||
+      (pool->workers = malloc(thread_count * sizeof(worker_t))) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < thread_count; i++) {
+    pool->workers[i].id = i;
+    pool->workers[i].pool = pool;
+    pthread_mutex_init(&pool->workers[i].lock, NULL);
+    pthread_cond_init(&pool->workers[i].cond, NULL);
+    pool->workers[i].generation = 0;
+    if ((rv = pthread_create(&pool->threads[i], NULL, worker_routine, &pool->workers[i])) != 0) {
+      fprintf(stderr, "Error creating thread: %i\n", rv);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+// run routine on the first active_count workers, worker i gets
+// args + i * arg_size (pass arg_size 0 to share one argument).
+// only those workers are woken. once they are all waiting at the release
+// point they are let go together, and this returns the nsecs from then
+// until the last one finishes, so waking them is not timed
+uint64_t pool_run(worker_pool_t *pool, int active_count, void *(*routine)(void *), void *args, size_t arg_size) {
+  if (active_count > pool->thread_count) {
+    fprintf(stderr, "Error running %d workers on a pool of %d\n", active_count, pool->thread_count);
+    exit(EXIT_FAILURE);
+  }
+  if (active_count == 0) {
+    return 0;
+  }
+  pool->active_count = active_count;
+  pool->routine = routine;
+  pool->args = args;
+  pool->arg_size = arg_size;
+  uint64_t generation = ++pool->generation;
+  atomic_store(&pool->ready, 0);
+  atomic_store(&pool->running, active_count);
+
+  for (int i = 0; i < active_count; i++) {
+    wake_worker(&pool->workers[i], generation);
+  }
+  int spins = 0;
+  while (atomic_load(&pool->ready) < active_count) {
+    spin(&spins);
+  }
+  timespec_t start;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+  atomic_store_explicit(&pool->release, generation, memory_order_release);
+
+  pthread_mutex_lock(&pool->done_lock);
+  while (atomic_load(&pool->running) > 0) {
+    pthread_cond_wait(&pool->done_cond, &pool->done_lock);
+  }
+  pthread_mutex_unlock(&pool->done_lock);
+
+  timespec_t *last = &pool->workers[0].end;
+  for (int i = 1; i < active_count; i++) {
+    if (timespec_before(last, &pool->workers[i].end)) {
+      last = &pool->workers[i].end;
+    }
+  }
+  return elapsed_nsecs(&start, last);
+}
+
+void pool_destroy(worker_pool_t *pool) {
+  pool->shutdown = 1;
+  uint64_t generation = ++pool->generation;
+  for (int i = 0; i < pool->thread_count; i++) {
+    wake_worker(&pool->workers[i], generation);
+  }
+  for (int i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->workers[i].cond);
+    pthread_mutex_destroy(&pool->workers[i].lock);
+  }
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_mutex_destroy(&pool->done_lock);
+  free(pool->threads);
+  free(pool->workers);
+}
@@ -0,0 +1,47 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "timer.h"
+
+typedef struct worker_pool_t worker_pool_t;
+
+// each worker parks on its own condition variable, so a run only wakes
+// the workers it uses
+typedef struct worker_t {
+  int id;
+  worker_pool_t *pool;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint64_t generation; // the last run this worker was woken for
+  timespec_t end;
+} worker_t;
+
+// threads are created once and parked between runs. the active ones wait
+// at a shared release point, spinning on release, so they all start at
+// once and the run is timed from there
+struct worker_pool_t {
+  int thread_count;
+  int active_count;
+  int shutdown;
+  pthread_t *threads;
+  worker_t *workers;
+  uint64_t generation;
+  atomic_int ready;     // active workers waiting for release
+  atomic_ulong release; // the run the active workers may start
+  atomic_int running;   // active workers not finished yet
+  pthread_mutex_t done_lock;
+  pthread_cond_t done_cond;
+  void *(*routine)(void *);
+  void *args;
+  size_t arg_size;
+};
+
+void pool_init(worker_pool_t *pool, int thread_count);
+uint64_t pool_run(worker_pool_t *pool, int active_count, void *(*routine)(void *), void *args, size_t arg_size);
+void pool_destroy(worker_pool_t *pool);
+
+#endif